@@ -3,6 +3,7 @@
 
 #include "game.hpp"
 
+#include <iostream>
 #include <string>
 #include <thread>
 
@@ -14,7 +15,17 @@ enum class UCICommand {
   Position,
   Go,
   Stop,
+  PonderHit,
   Quit,
+  TTStress,
+  SeeBench,
+  AttackBench,
+  MobilityBench,
+  Perft,
+  Divide,
+  PerftSuite,
+  Bench,
+  SMPBench,
   Unknown
 };
 
@@ -33,7 +44,8 @@ public:
     std::string lastCommand;
     std::string currentCommand;
 
-    int loop();
+    // Reads commands until "quit" or the end of 'input'
+    int loop(std::istream& input = std::cin);
 
     UCIHandler(/* args */);
     ~UCIHandler();
@@ -2,20 +2,90 @@
 
 #include <stdint.h>
 
+#include <array>
+
 #include "types.hpp"
 
+// Attack and line tables, all built at compile time
 namespace attack {
-    void computeKnightAttacks();
-    void computeKingAttacks();
-    void initRays();
-    void initPawnAttacks();
-    void init();
-    extern uint64_t knightAttacks[64];
-    extern uint64_t kingAttacks[64];
-    extern uint64_t Rays[8][64];
-    extern uint64_t pawnAttacks[2][64];
-    uint64_t getKingAttacks(int square, uint64_t occupancy);
-    uint64_t getKnightAttacks(int square, uint64_t occupancy);
-    uint64_t getPawnAttacks(int square, Color color, uint64_t occupancy);
+
+namespace detail {
+
+using Table = std::array<uint64_t, 64>;
+
+// (rank, file) steps
+constexpr int KNIGHT_STEPS[8][2] = {{-2, -1}, {-1, -2}, {1, -2}, {2, -1},
+                                    {2, 1},   {1, 2},   {-1, 2}, {-2, 1}};
+constexpr int KING_STEPS[8][2] = {{-1, -1}, {0, -1}, {1, -1}, {1, 0},
+                                  {1, 1},   {0, 1},  {-1, 1}, {-1, 0}};
+// Rays[] directions: N, S, E, W, NE, NW, SE, SW
+constexpr int RAY_STEPS[8][2] = {{1, 0}, {-1, 0}, {0, 1},  {0, -1},
+                                 {1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+
+constexpr bool onBoard(int rank, int file) {
+  return rank >= 0 && rank < 8 && file >= 0 && file < 8;
+}
+
+template <int N>
+constexpr Table leaperAttacks(const int (&steps)[N][2]) {
+  Table table{};
+  for (int sq = 0; sq < 64; sq++) {
+    for (const auto& step : steps) {
+      int rank = sq / 8 + step[0], file = sq % 8 + step[1];
+      if (onBoard(rank, file)) table[sq] |= 1ULL << (rank * 8 + file);
+    }
+  }
+  return table;
 }
 
+constexpr std::array<Table, 2> pawnAttacks() {
+  constexpr int white[2][2] = {{1, -1}, {1, 1}};
+  constexpr int black[2][2] = {{-1, -1}, {-1, 1}};
+  return {leaperAttacks(white), leaperAttacks(black)};
+}
+
+constexpr std::array<Table, 8> rays() {
+  std::array<Table, 8> table{};
+  for (int dir = 0; dir < 8; dir++) {
+    for (int sq = 0; sq < 64; sq++) {
+      int rank = sq / 8 + RAY_STEPS[dir][0], file = sq % 8 + RAY_STEPS[dir][1];
+      for (; onBoard(rank, file); rank += RAY_STEPS[dir][0], file += RAY_STEPS[dir][1]) {
+        table[dir][sq] |= 1ULL << (rank * 8 + file);
+      }
+    }
+  }
+  return table;
+}
+
+// The squares between a and b, or with 'whole' the full line through them
+constexpr std::array<Table, 64> lines(bool whole) {
+  constexpr int OPPOSITE[8] = {1, 0, 3, 2, 7, 6, 5, 4};
+  constexpr std::array<Table, 8> ray = rays();
+  std::array<Table, 64> table{};
+  for (int a = 0; a < 64; a++) {
+    for (int dir = 0; dir < 8; dir++) {
+      for (int b = 0; b < 64; b++) {
+        if (!(ray[dir][a] & (1ULL << b))) continue;
+        table[a][b] = whole ? ray[dir][a] | ray[OPPOSITE[dir]][a] | (1ULL << a)
+                            : ray[dir][a] & ray[OPPOSITE[dir]][b];
+      }
+    }
+  }
+  return table;
+}
+
+}  // namespace detail
+
+inline constexpr detail::Table knightAttacks = detail::leaperAttacks(detail::KNIGHT_STEPS);
+inline constexpr detail::Table kingAttacks = detail::leaperAttacks(detail::KING_STEPS);
+inline constexpr std::array<detail::Table, 8> Rays = detail::rays();
+inline constexpr std::array<detail::Table, 2> pawnAttacks = detail::pawnAttacks();
+// Squares strictly between a and b if they share a rank, file or diagonal, else 0
+inline constexpr std::array<detail::Table, 64> betweenMask = detail::lines(false);
+// The whole rank/file/diagonal through a and b (both included), else 0
+inline constexpr std::array<detail::Table, 64> lineMask = detail::lines(true);
+
+uint64_t getKingAttacks(int square, uint64_t occupancy);
+uint64_t getKnightAttacks(int square, uint64_t occupancy);
+uint64_t getPawnAttacks(int square, Color color, uint64_t occupancy);
+}  // namespace attack
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class Game;
+
+// Fixed-depth search over a fixed set of positions. The node total is a signature of
+// the search tree: any change to it means the search behaves differently, not just
+// faster or slower.
+namespace bench {
+
+constexpr int DEFAULT_DEPTH = 9;
+constexpr int DEFAULT_THREADS = 1;
+constexpr int DEFAULT_HASH_MB = 16;
+constexpr int DEFAULT_TTD_DEPTH = 12;
+constexpr int DEFAULT_TTD_HASH_MB = 256;
+
+// Restores the engine's thread count and hash size afterwards; returns the node total
+uint64_t run(Game& game, int depth, int threads, int hashMB);
+
+// Time to depth of Lazy SMP and ABDADA: searches the first few positions to 'depth' with
+// each thread count in turn, from an empty table each time, and reports time, nodes and
+// the speedup over the first count and (for ABDADA) over Lazy SMP. Restores the
+// thread count, hash size and parallel mode afterwards.
+void timeToDepth(Game& game, int depth, const std::vector<int>& threadCounts, int hashMB);
+
+}  // namespace bench
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+
+#include "types.hpp"
+
+// Endgame bitbases. KPK is generated by tools/kpkGenerator.cpp as part of the build and
+// compiled into the binary: one bit per position, set if the side with the pawn wins.
+namespace bitbase {
+
+// Positions are stored with White holding the pawn on files a-d, ranks 2-7
+constexpr int KPK_SIZE = 2 * 24 * 64 * 64;
+
+constexpr int kpkIndex(Color stm, int whiteKing, int blackKing, int pawn) {
+  return stm + 2 * (blackKing + 64 * (whiteKing + 64 * ((pawn / 8 - 1) * 4 + pawn % 8)));
+}
+
+// Any KPK position: mirrors it into the stored half and looks it up
+bool probeKPK(Color strongSide, int strongKing, int pawn, int weakKing, Color sideToMove);
+
+}  // namespace bitbase
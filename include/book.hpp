@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+
+#include "types.hpp"
+
+class Position;
+
+// Polyglot opening book (.bin). The file is mapped read-only and binary searched in
+// place: entries are 16 bytes, big-endian, sorted by key. No book is open until the
+// BookFile option names one (the repository ships data/gm2001.bin).
+class Book {
+ public:
+  static constexpr int DEFAULT_DEPTH = 20;  // Plies from the initial position
+  Book() = default;
+  ~Book();
+  Book(const Book&) = delete;
+  Book& operator=(const Book&) = delete;
+
+  // Maps 'path' (closing the current book first). Returns false if it can't be mapped;
+  // an empty path or "<empty>" just closes the book.
+  bool open(const std::string& path);
+  size_t size() const { return mCount; }
+  void close();
+  bool isOpen() const { return mEntries != nullptr; }
+
+  void setDepth(int plies) { mDepth = plies; }
+  // Always play the highest weighted move instead of picking by weight
+  void setBestOnly(bool best) { mBestOnly = best; }
+
+  // A legal book move for 'pos', or false if out of book (or past the book depth)
+  bool probe(Position& pos, Move& out);
+
+  // Polyglot hash of 'pos' (not the engine's own Zobrist key)
+  static uint64_t key(const Position& pos);
+
+ private:
+  const unsigned char* mEntries = nullptr;
+  size_t mCount = 0;
+  size_t mMappedBytes = 0;
+  int mDepth = DEFAULT_DEPTH;
+  bool mBestOnly = false;
+  std::mt19937 mRng{std::random_device{}()};
+};
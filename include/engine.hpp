@@ -4,32 +4,55 @@
 
 #include <atomic>
 #include <cstdint>
+#include <memory>
 #include <stop_token>
 #include <string>
+#include <vector>
 
+#include "evalHash.hpp"
+#include "material.hpp"
+#include "pawnTable.hpp"
 #include "position.hpp"
+#include "timeManager.hpp"
 #include "transposition.hpp"
 
+struct SearchThread;
+
+// How helper threads split the work when Threads > 1
+enum class SMPMode { LazySMP, ABDADA };
+
 class Engine {
  private:
   int mDepth;
+  int mSearchDepth;
   std::chrono::time_point<std::chrono::steady_clock> mStartTime;
-  int mTimeAllocated;
-  bool mStop;
-  long long nodes;
-  Move killerMoves[64][2];
-  int historyMoves[2][64][64];
-  std::vector<Move> getPV(Position& pos, int depth);
-
-  static constexpr int mvv_lva[6][6] = {
-      // Attacker: P, N, B, R, Q, K
-      {105, 205, 305, 405, 505, 605},  // Victim: Pawn
-      {104, 204, 304, 404, 504, 604},  // Victim: Knight
-      {103, 203, 303, 403, 503, 603},  // Victim: Bishop
-      {102, 202, 302, 402, 502, 602},  // Victim: Rook
-      {101, 201, 301, 401, 501, 601},  // Victim: Queen
-      {100, 200, 300, 400, 500, 600}   // Victim: King (Shouldn't happen, but safe to add)
-  };
+  TimeManager mTime;
+  int mMoveOverhead;
+  std::atomic<bool> mStop;
+  std::atomic<bool> mPondering;
+  std::vector<std::unique_ptr<SearchThread>> mThreads;
+  SMPMode mSMPMode;
+
+  // ABDADA "currently searching" markers, keyed by the child position hash
+  static constexpr int ABDADA_TABLE_SIZE = 1 << 15;
+  static constexpr int ABDADA_MIN_DEPTH = 3;
+  std::atomic<uint64_t> mSearching[ABDADA_TABLE_SIZE];
+  bool isBeingSearched(uint64_t key) const;
+  void startSearching(uint64_t key);
+  void finishSearching(uint64_t key);
+
+  int mMultiPV;
+  // Follows TT moves from the end of 'pv' until it is 'depth' moves long
+  void extendPV(Position& pos, std::vector<Move>& pv, int depth);
+  void iterativeDeepening(SearchThread& th, std::stop_token stoken);
+  void reportIteration(SearchThread& th, int depth, int multiPV);
+  long long elapsedMs() const;
+
+  // Aspiration windows (centipawns) for iterative deepening
+  static constexpr int ASPIRATION_WINDOW = 25;
+  static constexpr int ASPIRATION_MIN_DEPTH = 4;
+  // Losing captures (SEE < 0) are skipped at this depth and below
+  static constexpr int SEE_PRUNE_DEPTH = 2;
 
  public:
   std::atomic<int> mCurrentDepth;
@@ -37,23 +60,82 @@ class Engine {
   std::atomic<unsigned long long> mTimeSpentMs;
 
   Move mLastBestMove;
+  Move mPonderMove;
 
   static const int MAX_PLY = 64;
-  Move pvTable[MAX_PLY][MAX_PLY];
-  int pvLength[MAX_PLY];
+  // Tablebase wins: above any evaluation, below mate scores, and within the TT's int16
+  static const int TB_WIN = 25000;
+  static constexpr int MAX_THREADS = 256;
+  static constexpr int DEFAULT_MOVE_OVERHEAD = 70;
   TranspositionTable tt;
+  EvalHash evalHash;
 
   void setDepth(int depth);
   int getDepth();
+  void setThreads(int threads);
+  int getThreads() const;
+  // Nodes searched by all threads in the current (or last) search
+  uint64_t totalNodes() const;
+  void setMoveOverhead(int ms);
+  void setMultiPV(int lines);
+  void setSMPMode(SMPMode mode);
+  SMPMode getSMPMode() const;
 
-  int scoreMove(const Move& m, Position& pos, int ply);
+  int scoreMove(SearchThread& th, const Move& m, int ply);
   uint64_t mAlgebraicToBit(std::string alge);
-  Move search(Position& pos, int timeLimitMs, std::stop_token stoken);
-  int evaluate(Position& pos);
-  int quiescence(Position& pos, int alpha, int beta, std::stop_token& stoken);
-  int negaMax(Position& pos, int depth, int alpha, int beta, std::stop_token& stoken);
-  void pickMove(MoveList& list, int moveNum);
+  Move search(Position& pos, const SearchLimits& limits, std::stop_token stoken);
+  // The opponent played the expected move: keep searching, but on the clock from now on
+  void ponderhit();
+  // Static evaluation of th.pos from the side to move's point of view
+  int evaluate(SearchThread& th);
+  int searchRoot(SearchThread& th, int depth, int alpha, int beta, std::stop_token& stoken);
+  int quiescence(SearchThread& th, int alpha, int beta, std::stop_token& stoken);
+  int negaMax(SearchThread& th, int depth, int alpha, int beta, std::stop_token& stoken);
 
   Engine();
   ~Engine();
 };
+
+// A legal root move with the results of its last search. The list persists across
+// iterations and is kept sorted best-first, so it doubles as root move ordering.
+struct RootMove {
+  Move move;
+  int score = -1000000;
+  int previousScore = -1000000;
+  uint64_t nodes = 0;  // Size of this move's subtree in the last iteration
+  std::vector<Move> pv;
+
+  explicit RootMove(const Move& m) : move(m), pv{m} {}
+};
+
+// Per-thread search state for Lazy SMP. Every thread searches its own copy of the
+// root position with its own move ordering tables; only Engine::tt is shared.
+struct SearchThread {
+  int id = 0;
+  Position pos;
+  std::atomic<uint64_t> nodes{0};
+
+  Move killerMoves[Engine::MAX_PLY][2];
+  int historyMoves[2][64][64];
+  Move pvTable[Engine::MAX_PLY][Engine::MAX_PLY];
+  int pvLength[Engine::MAX_PLY];
+  // ABDADA siblings put off until the rest of the node is searched, per ply (unused in
+  // Lazy SMP, so kept here rather than in every negaMax frame)
+  Move deferred[Engine::MAX_PLY][256];
+  PawnTable pawnTable;
+  MaterialTable materialTable;
+
+  std::vector<RootMove> rootMoves;
+  int pvIdx = 0;    // MultiPV line currently being searched
+  int rootPly = 0;  // pos.gamePly at the root, so negaMax can compute its ply
+
+  int rootDepth = 0;
+  int completedDepth = 0;
+  int researches = 0;  // Aspiration window fail-high/fail-low re-searches
+  uint64_t tbHits = 0;
+  int bestScore = 0;
+  Move bestMove = Move::null();
+
+  // Resets ordering tables and results before a new search
+  void clear();
+};
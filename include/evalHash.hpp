@@ -0,0 +1,38 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+// Shared cache of static evaluations, indexed by Position::mHash. Each slot is one
+// 64-bit word: the upper 48 bits of the key with the 16-bit score in the low bits, so
+// a single relaxed load or store is a whole entry and no lock is needed.
+class EvalHash {
+ public:
+  static constexpr int DEFAULT_SIZE_MB = 8;
+  static constexpr int MAX_SIZE_MB = 1024;
+
+  explicit EvalHash(int sizeInMB);
+
+  // Reallocates (and so clears) the table; not safe while a search is running
+  void resize(int sizeInMB);
+  void clear();
+
+  bool probe(uint64_t key, int& score) const {
+    uint64_t word = mSlots[key & mMask].load(std::memory_order_relaxed);
+    if ((word ^ key) & KEY_MASK) return false;
+    score = (int16_t)(uint16_t)word;
+    return true;
+  }
+
+  void store(uint64_t key, int score) {
+    mSlots[key & mMask].store((key & KEY_MASK) | (uint16_t)(int16_t)score,
+                              std::memory_order_relaxed);
+  }
+
+ private:
+  static constexpr uint64_t KEY_MASK = ~0xFFFFULL;
+
+  std::unique_ptr<std::atomic<uint64_t>[]> mSlots;
+  uint64_t mMask = 0;
+};
@@ -1,6 +1,7 @@
 #ifndef GAME_HPP
 #define GAME_HPP
 
+#include "book.hpp"
 #include "engine.hpp"
 #include "position.hpp"
 #include "types.hpp"
@@ -10,6 +11,7 @@ class Game {
  public:
   Position position;
   Engine engine;
+  Book book;
 
   Game();
   ~Game();
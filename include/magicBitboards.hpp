@@ -13,9 +13,22 @@ struct Magic {
     int       shift;    // Shift amount
 };
 
+// How get_rook_attacks/get_bishop_attacks index the attack table: multiply-shift magics,
+// or BMI2 PEXT of the blockers. Auto picks PEXT where CPUID shows it is fast.
+enum class SliderBackend { Auto, Magic, Pext };
+
+// Fills the attack table for the Auto backend; only the first call does any work
 void init_magic_bitboards();
+// Switches backend and refills the table, so not while a search runs. False (and no
+// change) if PEXT is asked for on a CPU without BMI2.
+bool setSliderBackend(SliderBackend backend);
+const char* sliderBackendName();
 
 Bitboard get_rook_attacks(int square, Bitboard occupancy);
 Bitboard get_bishop_attacks(int square, Bitboard occupancy);
 
+// Looks up rook and bishop attacks for random squares and blockers for 'milliseconds'
+// and reports the rate. Returns the number of lookups.
+uint64_t attackBenchmark(int milliseconds);
+
 #endif
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include "types.hpp"
+
+class Position;
+
+// Endgame knowledge hooks. An evaluation function replaces the whole evaluation and
+// scores from strongSide's point of view; a scaling function returns how much of
+// strongSide's advantage survives, out of SCALE_NORMAL.
+using EndgameEvalFn = int (*)(const Position& pos, Color strongSide);
+using ScaleFn = int (*)(const Position& pos, Color strongSide);
+
+constexpr int SCALE_NORMAL = 64;
+constexpr int SCALE_DRAW = 0;
+constexpr int PHASE_MIDGAME = 24;  // Phase with all minor and major pieces on the board
+
+// Everything the evaluation derives from the piece counts alone
+struct MaterialEntry {
+  uint64_t key = 0;
+  int16_t imbalance = 0;  // White's point of view
+  uint8_t phase = 0;      // 0 (pawn endgame) .. PHASE_MIDGAME
+  Color strongSide = WHITE;
+  EndgameEvalFn evaluationFn = nullptr;
+  // Per side: applied when that side is ahead. The function, if set, wins over factor.
+  ScaleFn scaleFn[COLOR_NB] = {nullptr, nullptr};
+  uint8_t factor[COLOR_NB] = {SCALE_NORMAL, SCALE_NORMAL};
+
+  int scaleFactor(const Position& pos, Color strong) const {
+    return scaleFn[strong] ? scaleFn[strong](pos, strong) : factor[strong];
+  }
+};
+
+// Per-thread cache of material entries, indexed by Position::mMaterialKey. Few distinct
+// material configurations occur in a search, so it is small and almost always hits.
+class MaterialTable {
+ public:
+  static constexpr int SIZE = 1 << 13;  // Entries (power of two)
+
+  MaterialTable();
+
+  // Returns the entry for the position's material, computing it on a miss
+  MaterialEntry* probe(const Position& pos);
+
+ private:
+  std::unique_ptr<MaterialEntry[]> mEntries;
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+
+#include "position.hpp"
+
+// Set-wise mobility for the evaluation. All of a side's bishops (or rooks) are filled
+// at once with Kogge-Stone occluded fills, four directions per AVX2 vector, and the
+// attack sets are counted with vector popcounts; knights jump the same way, four
+// offsets per vector.
+//
+// This gives exactly the per-piece sums evalPieces used to compute: along one direction
+// a ray stops at the first occupied square, so the rays of two pieces of the same kind
+// never share a square, and the union per direction has as many squares as the rays
+// taken one piece at a time. The same holds for each of the eight knight jumps.
+namespace mobility {
+
+// Squares counted for one side, summed over its pieces: bishop and rook attacks
+// (blockers of either colour included), knight attacks not on own pieces
+struct Counts {
+  int bishop = 0;
+  int knight = 0;
+  int rook = 0;
+};
+
+// The kernel evalPieces uses. Per-piece lookups by default: on the hosts measured so far
+// the set-wise kernel is no faster.
+enum class MobilityKernel { PerPiece, Setwise };
+
+// Switches kernel; both give the same counts, so only speed changes. False (and no
+// change) if Setwise is asked for in a build without AVX2.
+bool setKernel(MobilityKernel kernel);
+const char* kernelName();
+
+// Counts with the selected kernel
+Counts evaluate(const Position& pos, Color side);
+
+// The vector kernel when compiled in. Without AVX2, filling one direction at a time
+// loses to a lookup per piece, so this falls back to countPerPiece.
+Counts count(const Position& pos, Color side);
+// One magic lookup and popcount per piece; the reference the kernel must match
+Counts countPerPiece(const Position& pos, Color side);
+// The kernel compiled in: "AVX2" or "scalar" (per-piece lookups)
+const char* simdName();
+
+// Counts both sides of a fixed set of positions with the kernel and with per-piece
+// lookups for 'milliseconds' each and reports both rates. Returns the number of
+// positions where the two disagree.
+uint64_t benchmark(int milliseconds);
+
+}  // namespace mobility
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "position.hpp"
+#include "types.hpp"
+
+// Hands out legal moves one at a time, best first, generating each stage only
+// when the previous one is used up:
+//   TT move -> winning captures -> killers -> quiets (by history) -> losing captures
+// Winning vs losing is decided by SEE, and only where MVV-LVA alone cannot tell.
+// A node that cuts off on the TT move or the first capture never generates quiets.
+// The quiescence variant only walks the capture stage.
+class MovePicker {
+ public:
+  // Main search
+  MovePicker(Position& pos, Move ttMove, const Move (&killers)[2],
+             const int (&history)[2][64][64]);
+  // Quiescence: captures only, in MVV-LVA order; losing captures are dropped
+  explicit MovePicker(Position& pos);
+
+  // Writes the next move to 'm'; false once every stage is exhausted
+  bool next(Move& m);
+  // The move just returned is a capture that loses material (SEE < 0)
+  bool isBadCapture() const { return mStage == BAD_CAPTURES; }
+
+ private:
+  enum Stage {
+    TT_MOVE,
+    INIT_CAPTURES,
+    GOOD_CAPTURES,
+    KILLER_1,
+    KILLER_2,
+    INIT_QUIETS,
+    QUIETS,
+    BAD_CAPTURES,
+    QS_INIT_CAPTURES,
+    QS_CAPTURES,
+    DONE
+  };
+
+  Position& mPos;
+  const int (*mHistory)[64];  // history[side to move]
+  Move mTTMove;
+  Move mKillers[2];
+  int mStage;
+
+  MoveList mMoves;
+  int mCurrent = 0;
+  MoveList mBadCaptures;
+  int mBadCurrent = 0;
+
+  void scoreCaptures();
+  void scoreQuiets();
+  // Swaps the best remaining move of mMoves into mCurrent (lazy selection sort)
+  Move pickBest();
+  bool isCaptureGood(const Move& m) const;
+  bool isSpecial(const Move& m) const;  // TT move or a killer: already handed out
+};
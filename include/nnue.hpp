@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "types.hpp"
+
+// Optional neural network evaluation. A (768 -> HIDDEN) x 2 -> 1 perspective network:
+// inputs are (color, piece, square) seen from each side, the first layer is kept up to
+// date incrementally by doMove/undoMove, and the output layer uses SCReLU.
+//
+// File layout (little-endian int16, the quantised raw format written by bullet):
+//   feature weights [768][HIDDEN], feature bias [HIDDEN],
+//   output weights [2 * HIDDEN] (side to move first), output bias
+// optionally padded to a multiple of 64 bytes.
+namespace nnue {
+
+constexpr int INPUTS = 768;
+constexpr int HIDDEN = 256;
+constexpr int QA = 255;     // First layer quantisation
+constexpr int QB = 64;      // Output layer quantisation
+constexpr int SCALE = 400;  // Network output -> centipawns
+// Largest |output weight|: the SIMD kernels multiply clamp(x, 0, QA) * w in 16 bits,
+// so nets beyond it are refused rather than evaluated differently per backend
+constexpr int MAX_OUTPUT_WEIGHT = 32767 / QA;
+
+struct alignas(64) Accumulator {
+  int16_t values[COLOR_NB][HIDDEN];
+};
+
+// One piece on one square, as it enters or leaves the board
+struct Feature {
+  int color;
+  int piece;
+  int square;
+};
+
+// Loads a network; on failure the previous state (loaded or not) is kept
+bool load(const std::string& path);
+void unload();
+bool isLoaded();
+// The kernel set compiled in: "AVX2", "SSE4.1" or "scalar"
+const char* simdName();
+
+void refresh(Accumulator& acc, const uint64_t (&pieces)[COLOR_NB][6]);
+// Applies up to two additions and two removals in one pass over the accumulator
+void update(Accumulator& acc, const Feature* added, int addedCount, const Feature* removed,
+            int removedCount);
+// Score in centipawns from the point of view of 'sideToMove'
+int evaluate(const Accumulator& acc, Color sideToMove);
+
+}  // namespace nnue
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include "types.hpp"
+
+enum Wing { KINGSIDE, QUEENSIDE };
+
+// Everything the evaluation derives from the pawns alone
+struct PawnEntry {
+  uint64_t key = 0;
+  uint64_t passed[COLOR_NB] = {0, 0};
+  int16_t score[COLOR_NB] = {0, 0};
+  // Penalty for the shield pawns missing in front of a castled king, per wing
+  int16_t shelter[COLOR_NB][2] = {{0, 0}, {0, 0}};
+};
+
+// Per-thread cache of pawn structure evaluations, indexed by Position::mPawnKey.
+// Single writer, so no locking; the caller fills the entry on a miss.
+class PawnTable {
+ public:
+  static constexpr int SIZE = 1 << 14;  // Entries (power of two)
+
+  PawnTable();
+
+  // Returns the slot for 'key'; 'found' tells whether it already holds that key
+  PawnEntry* probe(uint64_t key, bool& found);
+
+  // Hit rate statistics, reset by the owner
+  uint64_t probes = 0;
+  uint64_t hits = 0;
+
+ private:
+  std::unique_ptr<PawnEntry[]> mEntries;
+};
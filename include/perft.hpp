@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+class Position;
+
+// Move generator verification and throughput: leaf counts of the legal move tree
+// (getMoves + doMove + undoMove), with bulk counting at the last ply.
+namespace perft {
+
+// Subtree counts shared between threads; lockless like the TT (key XOR count)
+class PerftHash {
+ public:
+  explicit PerftHash(int sizeInMB);
+
+  bool probe(uint64_t key, int depth, uint64_t& count) const;
+  void store(uint64_t key, int depth, uint64_t count);
+
+ private:
+  struct Entry {
+    std::atomic<uint64_t> keyXorCount{0};
+    std::atomic<uint64_t> count{0};
+  };
+
+  std::unique_ptr<Entry[]> mEntries;
+  size_t mMask;
+};
+
+// Leaf nodes 'depth' plies below 'pos'; 'hash' may be null
+uint64_t count(Position& pos, int depth, PerftHash* hash);
+
+// Counts every root move on its own, the root moves shared out over 'threads'.
+// Prints the per-move counts when 'print' is set ("divide"), then the total and speed.
+uint64_t divide(Position& pos, int depth, int threads, int hashMB, bool print);
+
+// Standard positions with known counts; returns whether all of them matched
+bool runSuite(int threads, int hashMB);
+
+}  // namespace perft
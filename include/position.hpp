@@ -6,6 +6,7 @@
 #include <cstdint>
 #include <string>
 
+#include "nnue.hpp"
 #include "types.hpp"
 
 class Position {
@@ -26,12 +27,24 @@ class Position {
   int board[64];
 
   uint64_t mHash;
+  // Zobrist key of the pawns alone, for the pawn hash table
+  uint64_t mPawnKey;
+  // Depends only on how many pieces of each kind are on the board: the n-th piece of a
+  // kind contributes Zobrist::pieceKeys[color][piece][n - 1]
+  uint64_t mMaterialKey;
+
+  // Check info for the side to move: rebuilt after every move, restored from
+  // StateInfo on undo
+  uint64_t mCheckers = 0ULL;  // Enemy pieces giving check
+  uint64_t mPinned = 0ULL;    // Our pieces pinned to our king
 
   uint64_t getHash() const { return mHash; }
 
   int gamePly = 0;
 
   Eval posEval;
+  // First layer of the network, kept current by doMove/undoMove while one is loaded
+  nnue::Accumulator mAccumulator;
   uint64_t mAttacksP = 0ULL;
 
   // Full castling mask array
@@ -57,15 +70,57 @@ class Position {
   void undoMove(Move m);
   void doNullMove();
   void undoNullMove();
-  void getMoves(Color color, MoveList& moveList);
-  void getCaptures(Color color, MoveList& moveList);
+  // The generators only produce legal moves, and only for the side to move.
+  // generate<> picks the color-specialized instance once; QUIETS is everything CAPTURES
+  // leaves out: pushes (incl. quiet promotions), quiet piece moves and castling
+  template <GenType Type>
+  void generate(MoveList& moveList);
+  // All legal moves (EVASIONS or ALL)
+  void getMoves(MoveList& moveList);
   bool isSquareAttacked(int square, Color sideAttacking);
+  // Pieces of both colors attacking 'square' with the given occupancy
+  uint64_t attackersTo(int square, uint64_t occupancy) const;
+  // Could 'm' have come from the pseudo-legal generator here? Cheap check for moves
+  // taken from the TT
+  bool isPseudoLegal(Move m);
+  // Pseudo-legal move that does not leave our king in check (from the cached check
+  // info, no doMove)
+  bool isLegal(Move m);
+  // Static exchange evaluation: material won (or lost, if negative) by 'm' once every
+  // recapture on the target square has been played out, least valuable attacker first
+  int see(Move m) const;
+  // Runs SEE on the captures of a fixed set of positions for 'milliseconds' and reports
+  // the call rate. Returns the number of calls made.
+  static uint64_t seeBenchmark(int milliseconds);
   bool isRepetition();
-  bool isCheck();
+  bool isCheck() const { return mCheckers != 0; }
   bool hasNonPawnMaterial(Color side) const;
-  inline void addPawnCaptureMove(int from, int to, MoveList& moveList);
   uint64_t predictChildHash(Move m);
 
+  void updateCheckInfo();
+  void refreshAccumulator();
+  // Applies the piece changes of 'm' (described by 'st') to the accumulator, or takes
+  // them back
+  void updateAccumulator(Color us, Move m, const StateInfo& st, bool undo);
+  // Non-king targets allowed while in check: capture the checker or block it
+  uint64_t evasionTargets() const;
+  bool isEnPassantLegal(int from, int to) const;
+
+  template <Color Us, GenType Type>
+  void generate(MoveList& moveList);
+  // 'targets': squares non-king pieces may move to (already cut down to evasions)
+  template <Color Us, GenType Type>
+  void generatePawnMoves(uint64_t targets, MoveList& moveList);
+  template <Color Us, int Type>
+  void generatePieceMoves(uint64_t targets, MoveList& moveList);
+  template <Color Us>
+  void addCastlingMoves(MoveList& moveList);
+  // doMove/undoMove dispatch here on the side that moves
+  template <Color Us>
+  void doMove(Move m);
+  template <Color Us>
+  void undoMove(Move m);
+
   void printBoard();
 
   Position();
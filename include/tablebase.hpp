@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "types.hpp"
+
+class Position;
+
+// Win/draw/loss tables for 3- and 4-man endings, generated in-house by
+// tools/tbGenerator.cpp and memory-mapped from disk. The tables know nothing of
+// castling, en passant or the 50-move rule.
+//
+// One file per material, "<White>v<Black>.wdl" with the stronger side as White
+// (e.g. KRvKN.wdl):
+//   "BBXWDL1\0", uint32 positions, uint32 blocks
+//   uint32 block offsets [blocks + 1], relative to the start of the data
+//   data: each block of BLOCK_SIZE positions as run-length tokens
+namespace tablebase {
+
+constexpr int MAX_PIECES = 4;
+constexpr int BLOCK_SIZE = 4096;
+
+// From the side to move's point of view
+enum WDL { LOSS = -1, DRAW = 0, WIN = 1 };
+
+// Stored values; DONT_CARE marks illegal positions and never appears in a file
+enum Stored : uint8_t { STORED_LOSS, STORED_DRAW, STORED_WIN, DONT_CARE };
+
+// What the tables see of a position
+struct TBPosition {
+  int count = 0;
+  int piece[MAX_PIECES];
+  Color color[MAX_PIECES];
+  int square[MAX_PIECES];
+  Color sideToMove = WHITE;
+};
+
+// Piece layout of a table: White king, Black king, then White's and Black's other
+// pieces, strongest first. Symmetry pins the White king to a1-d1-d4 without pawns and
+// to files a-d with pawns.
+struct Material {
+  std::string name;
+  int count = 0;
+  int piece[MAX_PIECES];
+  Color color[MAX_PIECES];
+  bool hasPawns = false;
+
+  explicit Material(const std::string& name);  // e.g. "KRvKN"
+
+  uint64_t size() const;
+  // Squares in table order
+  uint64_t index(const int* squares, Color sideToMove) const;
+  void decode(uint64_t index, int* squares, Color& sideToMove) const;
+};
+
+// Every 3- and 4-man material with the stronger side as White
+std::vector<std::string> allTables();
+
+// Maps every table found in 'dir', replacing those loaded before; returns how many
+int init(const std::string& dir);
+// Largest piece count covered by the loaded tables (0 with none)
+int maxPieces();
+
+// False if no loaded table covers the position
+bool probe(const TBPosition& pos, WDL& result);
+bool probe(const Position& pos, WDL& result);
+
+// Compresses 'values' (indexed as in Material) into a table file
+bool write(const std::string& path, const std::vector<uint8_t>& values);
+
+}  // namespace tablebase
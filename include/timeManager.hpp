@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+#include "types.hpp"
+
+// Everything a "go" command can constrain the search with
+struct SearchLimits {
+  int time[COLOR_NB] = {0, 0};  // wtime / btime
+  int inc[COLOR_NB] = {0, 0};   // winc / binc
+  int movesToGo = 0;
+  int moveTime = 0;
+  int depth = 0;
+  bool infinite = false;
+  bool ponder = false;
+
+  bool usesClock() const { return time[WHITE] || time[BLACK] || moveTime; }
+};
+
+// Decides how long a search may run.
+// soft limit: no new iteration is started past it (scaled by best-move stability)
+// hard limit: the search is aborted mid-iteration past it
+class TimeManager {
+ public:
+  void init(const SearchLimits& limits, Color us, int moveOverhead);
+
+  // Milliseconds since init() (or since ponderhit)
+  long long elapsed() const;
+  int softLimit() const { return mSoft; }
+  int hardLimit() const { return mHard; }
+
+  bool hardLimitReached() const;
+  // Called between iterations: false if we are past the soft limit, or if the next
+  // iteration is not expected to finish before the hard limit
+  bool canStartIteration(long long lastIterationMs) const;
+  // Called after each completed iteration to stretch or shrink the soft limit
+  void update(bool bestMoveChanged, int scoreDrop);
+  // The clock starts for real on ponderhit
+  void ponderhit();
+
+ private:
+  static long long nowMs();
+
+  std::atomic<long long> mStartMs{0};
+  bool mEnabled = false;
+  bool mFixed = false;  // movetime: use exactly the budget
+  int mSoftBase = 0;
+  int mSoft = 0;
+  int mHard = 0;
+
+  double mBestMoveChanges = 0.0;
+  int mStableIterations = 0;
+};
@@ -1,19 +1,46 @@
 #pragma once
 
-#include <vector>
+#include <atomic>
+#include <cstddef>
 
 #include "types.hpp"
 
-struct alignas(16) TTEntry {
-  uint64_t key;
+// Unpacked contents of one TT slot. On the table it lives in a single 64-bit word:
+// move (16) | score (16) | depth (8) | flag (8) | generation (8)
+struct TTData {
   TTMove move;
   int16_t score;
   uint8_t depth;
   uint8_t flag;
   uint8_t generation;
-  uint8_t pad;
 
-  TTEntry() : key(0), move(), score(0), depth(0), flag(0), generation(0), pad(0) {}
+  TTData() : move(), score(0), depth(0), flag(0), generation(0) {}
+
+  uint64_t pack() const {
+    return (uint64_t)move.data | ((uint64_t)(uint16_t)score << 16) | ((uint64_t)depth << 32) |
+           ((uint64_t)flag << 40) | ((uint64_t)generation << 48);
+  }
+
+  static TTData unpack(uint64_t word) {
+    TTData d;
+    d.move.data = (uint16_t)word;
+    d.score = (int16_t)(uint16_t)(word >> 16);
+    d.depth = (uint8_t)(word >> 32);
+    d.flag = (uint8_t)(word >> 40);
+    d.generation = (uint8_t)(word >> 48);
+    return d;
+  }
+};
+
+// Lockless entry (key XOR data): the key is stored XORed with the data word, so a
+// slot half-written by another thread fails the key check instead of being returned.
+struct alignas(16) TTEntry {
+  std::atomic<uint64_t> keyXorData;
+  std::atomic<uint64_t> data;
+
+  uint64_t key() const {
+    return keyXorData.load(std::memory_order_relaxed) ^ data.load(std::memory_order_relaxed);
+  }
 };
 
 struct alignas(64) TTBucket {
@@ -22,13 +49,24 @@ struct alignas(64) TTBucket {
 
 class TranspositionTable {
  public:
-  std::vector<TTBucket> buckets;
-  size_t numBuckets;
+  static constexpr int DEFAULT_SIZE_MB = 64;
+  static constexpr int MAX_SIZE_MB = 65536;
+
+  TTBucket* buckets = nullptr;
+  size_t numBuckets = 0;
 
-  TranspositionTable(int sizeInMB);
+  explicit TranspositionTable(int sizeInMB);
   ~TranspositionTable();
+  TranspositionTable(const TranspositionTable&) = delete;
+  TranspositionTable& operator=(const TranspositionTable&) = delete;
 
-  void clear();
+  // Maps a new, empty table of the largest power-of-two bucket count that fits, backed
+  // by huge pages where the kernel allows. If the memory cannot be mapped, keeps the
+  // current table and returns false. Not safe while a search is running.
+  bool resize(int sizeInMB);
+  int sizeMB() const { return (int)(numBuckets * sizeof(TTBucket) >> 20); }
+  // Zeroes the table, split over up to 'threads' threads
+  void clear(int threads = 1);
   // Store a result in the table
   void store(uint64_t key, int depth, int ply, int score, uint8_t flag, Move move);
   // Retrieve a result (returns true if found and usable)
@@ -36,8 +74,17 @@ class TranspositionTable {
   // Just retrieve the move (for move ordering)
   Move probeMove(uint64_t key);
 
+  // Hammers one small table from many threads and counts entries that come back
+  // inconsistent with their key. Returns the number of torn reads (0 expected).
+  static uint64_t stressTest(int numThreads, int seconds);
+
  private:
    // Number of entries
   int scoreToTT(int score, int ply);
   int scoreFromTT(int score, int ply);
+  // Loads a slot; returns false if it does not hold 'key' (or was torn)
+  static bool read(const TTEntry& entry, uint64_t key, TTData& out);
+  void release();
+
+  size_t mMappedBytes = 0;
 };
@@ -10,6 +10,10 @@ enum CastlingRights { WHITE_OO = 1, WHITE_OOO = 2, BLACK_OO = 4, BLACK_OOO = 8 }
 
 enum Color { WHITE, BLACK, COLOR_NB };
 
+// What a move generator produces. EVASIONS assumes we are in check, ALL that we are not;
+// CAPTURES and QUIETS work either way.
+enum GenType { CAPTURES, QUIETS, EVASIONS, ALL };
+
 enum TTFlag { TT_EXACT, TT_ALPHA, TT_BETA };
 
 struct Move {
@@ -64,16 +68,6 @@ struct MoveList {
   inline void clear() { count = 0; }
 };
 
-// OPTIMIZED: Eval caching structure
-struct EvalCache {
-  bool valid = false;
-  int16_t pawnScore[2];      // [WHITE], [BLACK]
-  int16_t safetyScore[2];    // [WHITE], [BLACK]
-  int16_t mobilityScore[2];  // [WHITE], [BLACK]
-
-  void invalidate() { valid = false; }
-};
-
 struct StateInfo {
   int capturedPiece;
   int movedPiece;
@@ -84,7 +78,10 @@ struct StateInfo {
   int halfMove;
   int psqtScore;
   uint64_t zobristKey;
-  EvalCache evalCache;
+  uint64_t pawnKey;
+  uint64_t materialKey;
+  uint64_t checkers;
+  uint64_t pinned;
 };
 
 struct Eval {
@@ -108,6 +105,16 @@ static constexpr int pieceValues[6] = {
     20000  // KING
 };
 
+static constexpr int mvv_lva[6][6] = {
+    // Attacker: P, N, B, R, Q, K
+    {105, 104, 103, 102, 101, 100},  // Victim: Pawn
+    {205, 204, 203, 202, 201, 200},  // Victim: Knight
+    {305, 304, 303, 302, 301, 300},  // Victim: Bishop
+    {405, 404, 403, 402, 401, 400},  // Victim: Rook
+    {505, 504, 503, 502, 501, 500},  // Victim: Queen
+    {605, 604, 603, 602, 601, 600}   // Victim: King (Shouldn't happen, but safe to add)
+};
+
 static constexpr int PST[6][64] = {
     // PAWN
     {
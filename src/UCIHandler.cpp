@@ -9,7 +9,12 @@
 #include <unordered_map>
 
 #include "../include/attack.hpp"
+#include "../include/bench.hpp"
 #include "../include/magicBitboards.hpp"
+#include "../include/mobility.hpp"
+#include "../include/nnue.hpp"
+#include "../include/perft.hpp"
+#include "../include/tablebase.hpp"
 #include "../include/types.hpp"
 #include "../include/utils.hpp"
 
@@ -35,7 +40,7 @@ std::string UCIHandler::getStartingPosition(std::string commandLine) {
   return fenPosition;
 }
 
-int UCIHandler::loop() {
+int UCIHandler::loop(std::istream& input) {
   static const std::unordered_map<std::string, UCICommand> commandMap = {
       {"uci", UCICommand::Uci},
       {"isready", UCICommand::IsReady},
@@ -44,14 +49,23 @@ int UCIHandler::loop() {
       {"position", UCICommand::Position},
       {"go", UCICommand::Go},
       {"stop", UCICommand::Stop},
-      {"quit", UCICommand::Quit}};
+      {"ponderhit", UCICommand::PonderHit},
+      {"quit", UCICommand::Quit},
+      {"ttstress", UCICommand::TTStress},
+      {"seebench", UCICommand::SeeBench},
+      {"attackbench", UCICommand::AttackBench},
+      {"mobilitybench", UCICommand::MobilityBench},
+      {"perft", UCICommand::Perft},
+      {"divide", UCICommand::Divide},
+      {"perftsuite", UCICommand::PerftSuite},
+      {"bench", UCICommand::Bench},
+      {"smpbench", UCICommand::SMPBench}};
 
   init_magic_bitboards();
-  attack::init();
 
   std::string line;
   std::string token;
-  while (std::getline(std::cin, line)) {
+  while (std::getline(input, line)) {
     std::stringstream ss(line);
 
     if (ss >> token) {
@@ -62,6 +76,28 @@ int UCIHandler::loop() {
           case UCICommand::Uci:
             std::cout << "id name BigBroX 1.0" << std::endl;
             std::cout << "id author Hall T." << std::endl;
+            std::cout << "option name Hash type spin default " << TranspositionTable::DEFAULT_SIZE_MB
+                      << " min 1 max " << TranspositionTable::MAX_SIZE_MB << std::endl;
+            std::cout << "option name Threads type spin default 1 min 1 max " << Engine::MAX_THREADS
+                      << std::endl;
+            std::cout << "option name Move Overhead type spin default "
+                      << Engine::DEFAULT_MOVE_OVERHEAD << " min 0 max 5000" << std::endl;
+            std::cout << "option name MultiPV type spin default 1 min 1 max 256" << std::endl;
+            std::cout << "option name Ponder type check default false" << std::endl;
+            std::cout << "option name SMPMode type combo default LazySMP var LazySMP var ABDADA"
+                      << std::endl;
+            std::cout << "option name EvalFile type string default <empty>" << std::endl;
+            std::cout << "option name EvalHash type spin default " << EvalHash::DEFAULT_SIZE_MB
+                      << " min 1 max " << EvalHash::MAX_SIZE_MB << std::endl;
+            std::cout << "option name BookFile type string default <empty>" << std::endl;
+            std::cout << "option name BookDepth type spin default " << Book::DEFAULT_DEPTH
+                      << " min 0 max 200" << std::endl;
+            std::cout << "option name BookBestMove type check default false" << std::endl;
+            std::cout << "option name TablebasePath type string default <empty>" << std::endl;
+            std::cout << "option name SliderAttacks type combo default Auto var Auto var Magic"
+                      << " var PEXT" << std::endl;
+            std::cout << "option name Mobility type combo default PerPiece var PerPiece"
+                      << " var Setwise" << std::endl;
             std::cout << "uciok" << std::endl;
             break;
 
@@ -70,12 +106,115 @@ int UCIHandler::loop() {
             break;
 
           case UCICommand::UCINewGame:
-            game.engine.tt.clear();
-            sleep(1);
+            if (t1.joinable()) {
+              t1.request_stop();
+              t1.join();
+            }
+            game.engine.tt.clear(game.engine.getThreads());
             break;
 
-          case UCICommand::SetOption:
+          case UCICommand::SetOption: {
+            // setoption name <id> [value <x>]
+            std::string name;
+            std::string value;
+            ss >> token;  // "name"
+            while (ss >> token && token != "value") {
+              name += (name.empty() ? "" : " ") + token;
+            }
+            while (ss >> token) {
+              value += (value.empty() ? "" : " ") + token;
+            }
+
+            if (name == "Hash" && !value.empty()) {
+              if (t1.joinable()) {
+                t1.request_stop();
+                t1.join();
+              }
+              int sizeMB = std::clamp(std::stoi(value), 1, TranspositionTable::MAX_SIZE_MB);
+              if (!game.engine.tt.resize(sizeMB)) {
+                std::cout << "info string Hash: cannot allocate " << sizeMB << " MB, keeping "
+                          << game.engine.tt.sizeMB() << " MB" << std::endl;
+              }
+            } else if (name == "Threads" && !value.empty()) {
+              if (t1.joinable()) {
+                t1.request_stop();
+                t1.join();
+              }
+              game.engine.setThreads(std::stoi(value));
+            } else if (name == "Move Overhead" && !value.empty()) {
+              game.engine.setMoveOverhead(std::stoi(value));
+            } else if (name == "MultiPV" && !value.empty()) {
+              game.engine.setMultiPV(std::stoi(value));
+            } else if (name == "SMPMode") {
+              game.engine.setSMPMode(value == "ABDADA" ? SMPMode::ABDADA : SMPMode::LazySMP);
+            } else if (name == "EvalFile") {
+              // Never swap the weights under a running search
+              if (t1.joinable()) {
+                t1.request_stop();
+                t1.join();
+              }
+              if (value.empty() || value == "<empty>") {
+                nnue::unload();
+              } else if (nnue::load(value)) {
+                game.position.refreshAccumulator();
+              }
+              // Cached scores came from the previous evaluation
+              game.engine.evalHash.clear();
+            } else if (name == "EvalHash" && !value.empty()) {
+              if (t1.joinable()) {
+                t1.request_stop();
+                t1.join();
+              }
+              game.engine.evalHash.resize(
+                  std::clamp(std::stoi(value), 1, EvalHash::MAX_SIZE_MB));
+            } else if (name == "BookFile") {
+              if (game.book.open(value)) {
+                std::cout << "info string Book: " << value << " (" << game.book.size()
+                          << " entries)" << std::endl;
+              } else if (!value.empty() && value != "<empty>") {
+                std::cout << "info string Book: cannot map " << value << std::endl;
+              }
+            } else if (name == "BookDepth" && !value.empty()) {
+              game.book.setDepth(std::stoi(value));
+            } else if (name == "BookBestMove") {
+              game.book.setBestOnly(value == "true");
+            } else if (name == "TablebasePath") {
+              if (t1.joinable()) {
+                t1.request_stop();
+                t1.join();
+              }
+              int files = tablebase::init(value);
+              std::cout << "info string Tablebases: " << files << " files, up to "
+                        << tablebase::maxPieces() << " men" << std::endl;
+            } else if (name == "SliderAttacks") {
+              if (t1.joinable()) {
+                t1.request_stop();
+                t1.join();
+              }
+              SliderBackend backend = value == "Magic"  ? SliderBackend::Magic
+                                      : value == "PEXT" ? SliderBackend::Pext
+                                                        : SliderBackend::Auto;
+              if (setSliderBackend(backend)) {
+                std::cout << "info string Slider attacks: " << sliderBackendName() << std::endl;
+              } else {
+                std::cout << "info string Slider attacks: no BMI2 on this CPU, keeping "
+                          << sliderBackendName() << std::endl;
+              }
+            } else if (name == "Mobility") {
+              if (t1.joinable()) {
+                t1.request_stop();
+                t1.join();
+              }
+              if (mobility::setKernel(value == "Setwise" ? mobility::MobilityKernel::Setwise
+                                                         : mobility::MobilityKernel::PerPiece)) {
+                std::cout << "info string Mobility: " << mobility::kernelName() << std::endl;
+              } else {
+                std::cout << "info string Mobility: no AVX2 in this build, keeping "
+                          << mobility::kernelName() << std::endl;
+              }
+            }
             break;
+          }
 
           case UCICommand::Position: {
             std::string fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
@@ -115,7 +254,7 @@ int UCIHandler::loop() {
               Move target = util::parseUCIMove(moveStr);
               MoveList legalMoves;
 
-              game.position.getMoves(game.position.mSideToMove, legalMoves);
+              game.position.getMoves(legalMoves);
               bool found = false;
               for (int i = 0; i < legalMoves.count; i++) {
                 Move m = legalMoves.moves[i];
@@ -135,49 +274,47 @@ int UCIHandler::loop() {
 
           case UCICommand::Go: {
             if (t1.joinable()) t1.request_stop();
-            int wtime = 0;
-            int btime = 0;
-            int winc = 0;
-            int binc = 0;
-            int movetime = 0;
+            SearchLimits limits;
 
             while (ss >> token) {
               if (token == "wtime") {
                 ss >> token;
-                wtime = std::stoi(token);
+                limits.time[WHITE] = std::stoi(token);
               } else if (token == "btime") {
                 ss >> token;
-                btime = std::stoi(token);
+                limits.time[BLACK] = std::stoi(token);
               } else if (token == "winc") {
                 ss >> token;
-                winc = std::stoi(token);
+                limits.inc[WHITE] = std::stoi(token);
               } else if (token == "binc") {
                 ss >> token;
-                binc = std::stoi(token);
-              } else if (token == "winc") {
+                limits.inc[BLACK] = std::stoi(token);
+              } else if (token == "movestogo") {
                 ss >> token;
-                winc = std::stoi(token);
+                limits.movesToGo = std::stoi(token);
               } else if (token == "movetime") {
                 ss >> token;
-                movetime = std::stoi(token);
+                limits.moveTime = std::stoi(token);
+              } else if (token == "ponder") {
+                limits.ponder = true;
               } else if (token == "infinite") {
-                movetime = 2000000000;
+                limits.infinite = true;
               } else if (token == "depth") {
                 ss >> token;
-                game.engine.setDepth(std::stoi(token));
-                movetime = 2000000000;
+                limits.depth = std::stoi(token);
               }
             }
 
-            int allocatedTime = movetime;
-            if (!allocatedTime) {
-              allocatedTime = (game.position.mSideToMove == WHITE) ? ((wtime / 30) + winc)
-                                                                   : ((btime / 30) + binc);
-              allocatedTime = std::max(10, allocatedTime - 70);
+            // Known theory: answer straight from the book, no search
+            Move bookMove;
+            if (!limits.ponder && !limits.infinite && game.book.probe(game.position, bookMove)) {
+              if (t1.joinable()) t1.join();
+              std::cout << "bestmove " << util::moveToString(bookMove) << std::endl;
+              break;
             }
 
-            t1 = std::jthread([this, allocatedTime](std::stop_token st) {
-              game.engine.search(game.position, allocatedTime, st);
+            t1 = std::jthread([this, limits](std::stop_token st) {
+              game.engine.search(game.position, limits, st);
             });
 
             break;
@@ -191,6 +328,107 @@ int UCIHandler::loop() {
             break;
           }
 
+          case UCICommand::PonderHit:
+            game.engine.ponderhit();
+            break;
+
+          case UCICommand::TTStress: {
+            // ttstress [threads] [seconds]
+            int threads = std::max(2u, std::thread::hardware_concurrency());
+            int seconds = 5;
+            if (ss >> token) threads = std::stoi(token);
+            if (ss >> token) seconds = std::stoi(token);
+            uint64_t torn = TranspositionTable::stressTest(threads, seconds);
+            std::cout << (torn == 0 ? "ttstress passed" : "ttstress FAILED") << std::endl;
+            break;
+          }
+
+          case UCICommand::SeeBench: {
+            // seebench [milliseconds]
+            int milliseconds = 3000;
+            if (ss >> token) milliseconds = std::stoi(token);
+            Position::seeBenchmark(milliseconds);
+            break;
+          }
+
+          case UCICommand::AttackBench: {
+            // attackbench [milliseconds]
+            int milliseconds = 3000;
+            if (ss >> token) milliseconds = std::stoi(token);
+            attackBenchmark(milliseconds);
+            break;
+          }
+
+          case UCICommand::MobilityBench: {
+            // mobilitybench [milliseconds], per kernel
+            int milliseconds = 3000;
+            if (ss >> token) milliseconds = std::stoi(token);
+            mobility::benchmark(milliseconds);
+            break;
+          }
+
+          case UCICommand::Perft:
+          case UCICommand::Divide: {
+            // perft|divide <depth> [threads] [hashMB], on the current position
+            if (t1.joinable()) {
+              t1.request_stop();
+              t1.join();
+            }
+            int depth = 5, threads = 1, hashMB = 0;
+            if (ss >> token) depth = std::stoi(token);
+            if (ss >> token) threads = std::stoi(token);
+            if (ss >> token) hashMB = std::stoi(token);
+            perft::divide(game.position, depth, threads, hashMB,
+                          it->second == UCICommand::Divide);
+            break;
+          }
+
+          case UCICommand::PerftSuite: {
+            // perftsuite [threads] [hashMB]
+            if (t1.joinable()) {
+              t1.request_stop();
+              t1.join();
+            }
+            int threads = 1, hashMB = 0;
+            if (ss >> token) threads = std::stoi(token);
+            if (ss >> token) hashMB = std::stoi(token);
+            perft::runSuite(threads, hashMB);
+            break;
+          }
+
+          case UCICommand::Bench: {
+            // bench [depth] [threads] [hashMB]
+            if (t1.joinable()) {
+              t1.request_stop();
+              t1.join();
+            }
+            int depth = bench::DEFAULT_DEPTH, threads = bench::DEFAULT_THREADS,
+                hashMB = bench::DEFAULT_HASH_MB;
+            if (ss >> token) depth = std::stoi(token);
+            if (ss >> token) threads = std::stoi(token);
+            if (ss >> token) hashMB = std::stoi(token);
+            bench::run(game, depth, threads, hashMB);
+            break;
+          }
+
+          case UCICommand::SMPBench: {
+            // smpbench [depth] [hashMB] [threads...], threads 1 8 16 32 by default
+            if (t1.joinable()) {
+              t1.request_stop();
+              t1.join();
+            }
+            int depth = bench::DEFAULT_TTD_DEPTH, hashMB = bench::DEFAULT_TTD_HASH_MB;
+            std::vector<int> threads;
+            if (ss >> token) depth = std::stoi(token);
+            if (ss >> token) hashMB = std::stoi(token);
+            while (ss >> token) {
+              threads.push_back(std::clamp(std::stoi(token), 1, Engine::MAX_THREADS));
+            }
+            if (threads.empty()) threads = {1, 8, 16, 32};
+            bench::timeToDepth(game, depth, threads, hashMB);
+            break;
+          }
+
           case UCICommand::Quit:
             std::cout << "quitting" << std::endl;
             return 0;
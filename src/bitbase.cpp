@@ -0,0 +1,23 @@
+#include "../include/bitbase.hpp"
+
+// Generated at build time into the build tree
+#include "kpkBitbase.inc"
+
+bool bitbase::probeKPK(Color strongSide, int strongKing, int pawn, int weakKing,
+                       Color sideToMove) {
+  // Make the strong side White, then put the pawn on files a-d
+  if (strongSide == BLACK) {
+    strongKing ^= 56;
+    pawn ^= 56;
+    weakKing ^= 56;
+    sideToMove = (sideToMove == WHITE) ? BLACK : WHITE;
+  }
+  if (pawn % 8 > 3) {
+    strongKing ^= 7;
+    pawn ^= 7;
+    weakKing ^= 7;
+  }
+
+  int index = kpkIndex(sideToMove, strongKing, weakKing, pawn);
+  return (KPK_BITS[index / 32] >> (index % 32)) & 1;
+}
@@ -1,14 +1,23 @@
 #include "../include/engine.hpp"
 
+#include <algorithm>
 #include <chrono>
 #include <iostream>
+#include <thread>
 
 #include "../include/attack.hpp"
 #include "../include/magicBitboards.hpp"
+#include "../include/mobility.hpp"
+#include "../include/movePicker.hpp"
+#include "../include/nnue.hpp"
+#include "../include/tablebase.hpp"
 #include "../include/types.hpp"
 #include "../include/utils.hpp"
 
-const int INF = 1000000;
+// Mates score +-(INF - ply); with INF within int16 they survive the TT's 16-bit score
+// field, and sit above tablebase wins (Engine::TB_WIN)
+const int INF = 32000;
+static_assert(INF - Engine::MAX_PLY > Engine::TB_WIN && INF <= INT16_MAX);
 
 const uint64_t FILE_A = 0x0101010101010101ULL;
 
@@ -52,8 +61,19 @@ const int DOUBLED_PENALTY = 15;
 const int ISOLATED_PENALTY = 20;
 const int PASSED_BONUS[8] = {0, 10, 30, 50, 75, 100, 150, 200};  // Bonus increases by rank
 
-int evalPawns(const Position& pos, Color side) {
+// King Safety Penalties (in centipawns)
+const int KING_SHIELD_PENALTY = 20;  // Per missing shield pawn
+
+const uint64_t KING_SIDE_MASK_W = (1ULL << 5) | (1ULL << 6) | (1ULL << 7);      // f1, g1, h1
+const uint64_t KING_SIDE_MASK_B = (1ULL << 61) | (1ULL << 62) | (1ULL << 63);   // f8, g8, h8
+const uint64_t QUEEN_SIDE_MASK_W = (1ULL << 0) | (1ULL << 1) | (1ULL << 2);     // a1, b1, c1
+const uint64_t QUEEN_SIDE_MASK_B = (1ULL << 56) | (1ULL << 57) | (1ULL << 58);  // a8, b8, c8
+
+// Fills in the pawn-only terms of 'entry' for 'side': structure score, passed pawns and
+// the shield penalty for a king castled on either wing
+void evalPawns(const Position& pos, Color side, PawnEntry& entry) {
   int score = 0;
+  uint64_t passed = 0;
   uint64_t myPawns = pos.pieces[side][PAWN];
   uint64_t enemyPawns = pos.pieces[side ^ 1][PAWN];
 
@@ -67,6 +87,7 @@ int evalPawns(const Position& pos, Color side) {
     // 1. PASSED PAWN (No enemy pawns in front or adjacent files)
     if (!(PASSED_MASK[side][sq] & enemyPawns)) {
       score += PASSED_BONUS[relativeRank];
+      passed |= 1ULL << sq;
     }
 
     // 2. ISOLATED PAWN (No friendly pawns on adjacent files)
@@ -83,18 +104,20 @@ int evalPawns(const Position& pos, Color side) {
 
     tempPawns &= (tempPawns - 1);
   }
-  return score;
-}
 
-// King Safety Penalties (in centipawns)
-const int KING_SHIELD_PENALTY = 20;  // Per missing shield pawn
+  entry.score[side] = score;
+  entry.passed[side] = passed;
 
-const uint64_t KING_SIDE_MASK_W = (1ULL << 5) | (1ULL << 6) | (1ULL << 7);      // f1, g1, h1
-const uint64_t KING_SIDE_MASK_B = (1ULL << 61) | (1ULL << 62) | (1ULL << 63);   // f8, g8, h8
-const uint64_t QUEEN_SIDE_MASK_W = (1ULL << 0) | (1ULL << 1) | (1ULL << 2);     // a1, b1, c1
-const uint64_t QUEEN_SIDE_MASK_B = (1ULL << 56) | (1ULL << 57) | (1ULL << 58);  // a8, b8, c8
+  // Bitwise Shield Check: count the squares in front of the king where pawns are MISSING
+  uint64_t kingShield = (side == WHITE) ? (KING_SIDE_MASK_W << 8) : (KING_SIDE_MASK_B >> 8);
+  uint64_t queenShield = (side == WHITE) ? (QUEEN_SIDE_MASK_W << 8) : (QUEEN_SIDE_MASK_B >> 8);
+  entry.shelter[side][KINGSIDE] =
+      __builtin_popcountll(kingShield & ~myPawns) * KING_SHIELD_PENALTY;
+  entry.shelter[side][QUEENSIDE] =
+      __builtin_popcountll(queenShield & ~myPawns) * KING_SHIELD_PENALTY;
+}
 
-int evalKingSafety(const Position& pos, Color side) {
+int evalKingSafety(const Position& pos, Color side, const PawnEntry& entry) {
   // 1. Fast Exit: If King is not on back rank, skip safety check
   // (This saves time in endgames/middle-of-board chaos)
   uint64_t kingBB = pos.pieces[side][KING];
@@ -104,73 +127,30 @@ int evalKingSafety(const Position& pos, Color side) {
     if (!(kingBB & 0xFF00000000000000ULL)) return 0;  // King not on rank 8
   }
 
-  int score = 0;
-  int kingSq = __builtin_ctzll(kingBB);
-  int file = kingSq % 8;
-  uint64_t pawns = pos.pieces[side][PAWN];
-
-  // 2. Bitwise Shield Check
-  if (file > 4) {  // Kingside
-    uint64_t shieldMask = (side == WHITE) ? (KING_SIDE_MASK_W << 8) : (KING_SIDE_MASK_B >> 8);
-
-    // We want pawns to be present in the shieldMask
-    // XOR gives us the bits where pawns are MISSING
-    uint64_t missing = (shieldMask & ~pawns);
-
-    // Count missing pawns instantly
-    int missingCount = __builtin_popcountll(missing);
-    score -= (missingCount * KING_SHIELD_PENALTY);
-
-  } else if (file < 3) {  // Queenside
-    uint64_t shieldMask = (side == WHITE) ? (QUEEN_SIDE_MASK_W << 8) : (QUEEN_SIDE_MASK_B >> 8);
-    uint64_t missing = (shieldMask & ~pawns);
-    int missingCount = __builtin_popcountll(missing);
-    score -= (missingCount * KING_SHIELD_PENALTY);
-  }
-
-  return score;
+  // 2. Shield penalty, cached in the pawn entry
+  int file = __builtin_ctzll(kingBB) % 8;
+  if (file > 4) return -entry.shelter[side][KINGSIDE];
+  if (file < 3) return -entry.shelter[side][QUEENSIDE];
+  return 0;
 }
 
 const int ROOK_OPEN_FILE_BONUS = 10;
 const int ROOK_SEMI_OPEN_FILE_BONUS = 5;
 const int ROOK_ON_7TH_BONUS = 20;
 
-const int BISHOP_PAIR_BONUS = 30;
-
 const int KNIGHT_MOBILITY = 4;
 const int BISHOP_MOBILITY = 5;
 const int ROOK_MOBILITY = 3;
 
 int evalPieces(const Position& pos, Color side) {
   int score = 0;
-  uint64_t occupancy = pos.occupancies[2];
   uint64_t myPawns = pos.pieces[side][PAWN];
   uint64_t enemyPawns = pos.pieces[side ^ 1][PAWN];
 
-  // --- BISHOPS ---
-  uint64_t bishops = pos.pieces[side][BISHOP];
-  if (__builtin_popcountll(bishops) >= 2) score += BISHOP_PAIR_BONUS;
-
-  while (bishops) {
-    int sq = __builtin_ctzll(bishops);
-
-    // Mobility: Count attacked squares
-    uint64_t attacks = get_bishop_attacks(sq, occupancy);
-    score += __builtin_popcountll(attacks) * BISHOP_MOBILITY;
-
-    bishops &= (bishops - 1);
-  }
-
-  // --- KNIGHTS ---
-  uint64_t knights = pos.pieces[side][KNIGHT];
-  while (knights) {
-    int sq = __builtin_ctzll(knights);
-    // We use the precomputed attack table directly
-    uint64_t attacks = attack::knightAttacks[sq];
-    // We don't care about occupancy for knight mobility (freedom of movement)
-    score += __builtin_popcountll(attacks & ~pos.occupancies[side]) * KNIGHT_MOBILITY;
-    knights &= (knights - 1);
-  }
+  // Mobility, all pieces of a kind at once (the bishop pair bonus is part of the
+  // material imbalance)
+  mobility::Counts mob = mobility::evaluate(pos, side);
+  score += mob.bishop * BISHOP_MOBILITY + mob.knight * KNIGHT_MOBILITY + mob.rook * ROOK_MOBILITY;
 
   // --- ROOKS ---
   uint64_t rooks = pos.pieces[side][ROOK];
@@ -179,10 +159,6 @@ int evalPieces(const Position& pos, Color side) {
     int file = sq % 8;
     int rank = sq / 8;
 
-    // Mobility
-    uint64_t attacks = get_rook_attacks(sq, occupancy);
-    score += __builtin_popcountll(attacks) * ROOK_MOBILITY;
-
     // Static Open File Bonus (Reduced, but still useful)
     uint64_t fileMask = FILE_A << file;
     if (!(myPawns & fileMask)) {
@@ -207,54 +183,25 @@ int evalPieces(const Position& pos, Color side) {
   return score;
 }
 
-std::vector<Move> Engine::getPV(Position& pos, int depth) {
-  std::vector<Move> pv;
-  int ply = 0;
-  while (ply < depth) {
+void Engine::extendPV(Position& pos, std::vector<Move>& pv, int depth) {
+  for (const Move& m : pv) pos.doMove(m);
+
+  while ((int)pv.size() < depth) {
     Move m = tt.probeMove(pos.getHash());
     if (m.from == 0 && m.to == 0) break;  // No move in TT
-    MoveList moves;
-    pos.getMoves(pos.mSideToMove, moves);
-    bool legal = false;
-    for (int i = 0; i < moves.count; i++) {
-      if (moves.moves[i].from == m.from && moves.moves[i].to == m.to) {
-        legal = true;
-        break;
-      }
-    }
-    if (!legal) break;
+    // The TT is shared and keys can collide: validate before playing it
+    if (!pos.isPseudoLegal(m) || !pos.isLegal(m)) break;
     pv.push_back(m);
     pos.doMove(m);
-    ply++;
-  }
-  for (int i = pv.size() - 1; i >= 0; i--) {
-    pos.undoMove(pv[i]);
-  }
-  return pv;
-}
-
-void Engine::pickMove(MoveList& list, int moveNum) {
-  int bestIndex = -1;
-  int bestScore = -1000000;
-
-  // 1. Find the move with the highest score
-  for (int i = moveNum; i < list.count; ++i) {
-    if (list.moves[i].score > bestScore) {
-      bestScore = list.moves[i].score;
-      bestIndex = i;
-    }
   }
 
-  // 2. Swap it with the move at 'moveNum' so it gets searched next
-  if (bestIndex != -1) {
-    // Swap moves
-    Move tempMove = list.moves[moveNum];
-    list.moves[moveNum] = list.moves[bestIndex];
-    list.moves[bestIndex] = tempMove;
+  for (int i = (int)pv.size() - 1; i >= 0; i--) {
+    pos.undoMove(pv[i]);
   }
 }
 
-int Engine::scoreMove(const Move& m, Position& pos, int ply) {
+int Engine::scoreMove(SearchThread& th, const Move& m, int ply) {
+  Position& pos = th.pos;
   int score = 0;
 
   // Look up what pieces are involved using the board array
@@ -271,9 +218,9 @@ int Engine::scoreMove(const Move& m, Position& pos, int ply) {
   }
   // Check if ply is valid (>= 0) because Quiescence passes -1 to disable this
   else if (ply >= 0 && ply < MAX_PLY) {
-    if (m.from == killerMoves[ply][0].from && m.to == killerMoves[ply][0].to) {
+    if (m.from == th.killerMoves[ply][0].from && m.to == th.killerMoves[ply][0].to) {
       score = 9000;
-    } else if (m.from == killerMoves[ply][1].from && m.to == killerMoves[ply][1].to) {
+    } else if (m.from == th.killerMoves[ply][1].from && m.to == th.killerMoves[ply][1].to) {
       score = 8000;
     }
   }
@@ -289,30 +236,33 @@ int Engine::scoreMove(const Move& m, Position& pos, int ply) {
   }
 
   if (score == 0) {
-    score = historyMoves[pos.mSideToMove][m.from][m.to];
+    score = th.historyMoves[pos.mSideToMove][m.from][m.to];
   }
 
   return score;
 }
 
-int Engine::quiescence(Position& pos, int alpha, int beta, std::stop_token& stoken) {
+int Engine::quiescence(SearchThread& th, int alpha, int beta, std::stop_token& stoken) {
+  Position& pos = th.pos;
   if (pos.gamePly > 5000) return 0;
 
-  if ((nodes & 2047) == 0) {
+  if ((th.nodes & 2047) == 0) {
     if (stoken.stop_requested()) return 0;
-    auto now = std::chrono::steady_clock::now();
-    long long elapsed =
-        std::chrono::duration_cast<std::chrono::milliseconds>(now - mStartTime).count();
-    if (elapsed >= mTimeAllocated) {
+    if (!mPondering && mTime.hardLimitReached()) {
       mStop = true;
       return 0;
     }
   }
-  nodes++;
+  th.nodes.fetch_add(1, std::memory_order_relaxed);
 
-  // OPTIMIZATION: Stand-pat using only material/PSQT (very cheap!)
-  int standPat = pos.posEval.positionScore;
-  standPat = (pos.mSideToMove == WHITE) ? standPat : -standPat;
+  // Stand-pat: the network if one is loaded, else material/PSQT (both incremental)
+  int standPat;
+  if (nnue::isLoaded()) {
+    standPat = nnue::evaluate(pos.mAccumulator, pos.mSideToMove);
+  } else {
+    standPat = pos.posEval.positionScore;
+    standPat = (pos.mSideToMove == WHITE) ? standPat : -standPat;
+  }
 
   // OPTIMIZATION: Delta pruning
   // If we're so far behind that even capturing a queen can't help, give up
@@ -331,49 +281,14 @@ int Engine::quiescence(Position& pos, int alpha, int beta, std::stop_token& stok
     alpha = standPat;
   }
 
-  // Generate and search captures
-  MoveList captureList;
-  pos.getCaptures(pos.mSideToMove, captureList);
-
-  // Score captures using MVV-LVA
-  for (int i = 0; i < captureList.count; i++) {
-    Move& move = captureList.moves[i];
-    int victim = pos.board[move.to];
-    int attacker = pos.board[move.from];
-
-    if (victim != NOPIECE && attacker != NOPIECE) {
-      move.score = mvv_lva[victim][attacker];
-    } else if (move.promotion != NOPIECE) {
-      move.score = 1000 + pieceValues[move.promotion];
-    } else {
-      move.score = 0;
-    }
-  }
-
   // Search captures in order of MVV-LVA
-  for (int i = 0; i < captureList.count; i++) {
-    pickMove(captureList, i);
-    Move move = captureList.moves[i];
-
-    // OPTIMIZATION: SEE pruning for bad captures
-    // Skip captures that lose material (you'd need to implement SEE)
-    // For now, skip low-scoring captures when far below alpha
-    if (move.score < 100 && standPat + 200 < alpha) {
-      continue;  // Probably a bad capture
-    }
+  MovePicker picker(pos);
+  Move move;
 
+  // Captures that lose material (SEE < 0) never come out of the picker
+  while (picker.next(move)) {
     pos.doMove(move);
-
-    // Check legality
-    Color sideJustMoved = (pos.mSideToMove == WHITE) ? BLACK : WHITE;
-    int kingSquare = __builtin_ctzll(pos.pieces[sideJustMoved][KING]);
-
-    if (pos.isSquareAttacked(kingSquare, pos.mSideToMove)) {
-      pos.undoMove(move);
-      continue;
-    }
-
-    int score = -quiescence(pos, -beta, -alpha, stoken);
+    int score = -quiescence(th, -beta, -alpha, stoken);
     pos.undoMove(move);
 
     if (stoken.stop_requested()) return 0;
@@ -385,31 +300,45 @@ int Engine::quiescence(Position& pos, int alpha, int beta, std::stop_token& stok
   return alpha;
 }
 
-int Engine::negaMax(Position& pos, int depth, int alpha, int beta, std::stop_token& stoken) {
+int Engine::negaMax(SearchThread& th, int depth, int alpha, int beta, std::stop_token& stoken) {
+  Position& pos = th.pos;
   if (stoken.stop_requested()) return 0;
 
-  if ((nodes & 2047) == 0) {
-    auto now = std::chrono::steady_clock::now();
-    long long elapsed =
-        std::chrono::duration_cast<std::chrono::milliseconds>(now - mStartTime).count();
-
-    if (elapsed >= mTimeAllocated) {
+  if ((th.nodes & 2047) == 0) {
+    if (!mPondering && mTime.hardLimitReached()) {
       mStop = true;
     }
   }
-  nodes++;
+  th.nodes.fetch_add(1, std::memory_order_relaxed);
 
   if (mStop) return 0;
 
   bool inCheck = pos.isCheck();
 
-  int ply = mCurrentDepth - depth;
-  pvLength[ply] = ply;
+  int ply = pos.gamePly - th.rootPly;
+  th.pvLength[ply] = ply;
 
   if (ply > 0) {
     if (pos.isRepetition() || pos.mHalfMove >= 100) {
       return 0;
     }
+
+    // KPK is solved: the bitbase (through evaluate) is exact, no need to search it out
+    if (__builtin_popcountll(pos.occupancies[2]) == 3 &&
+        (pos.pieces[WHITE][PAWN] | pos.pieces[BLACK][PAWN])) {
+      return evaluate(th);
+    }
+
+    // Probe right after a capture or pawn move, so the 50-move rule the tables ignore
+    // has been reset; quiet moves inside the ending are still searched out
+    if (pos.mHalfMove == 0 && pos.mCastleRight == 0 && pos.mEnPassentSquare == 0 &&
+        __builtin_popcountll(pos.occupancies[2]) <= tablebase::maxPieces()) {
+      tablebase::WDL wdl;
+      if (tablebase::probe(pos, wdl)) {
+        th.tbHits++;
+        return wdl == tablebase::DRAW ? 0 : wdl == tablebase::WIN ? TB_WIN - ply : -TB_WIN + ply;
+      }
+    }
   }
 
   int ttScore;
@@ -426,7 +355,7 @@ int Engine::negaMax(Position& pos, int depth, int alpha, int beta, std::stop_tok
   }
 
   if (depth == 0) {
-    return quiescence(pos, alpha, beta, stoken);
+    return quiescence(th, alpha, beta, stoken);
   }
 
   // --- NULL MOVE PRUNING ---
@@ -435,7 +364,7 @@ int Engine::negaMax(Position& pos, int depth, int alpha, int beta, std::stop_tok
   // 2. We have enough depth to make it worth it (depth >= 3)
   // 3. We are NOT in check (null move while in check is illegal)
   // 4. We have major pieces (avoids zugzwang in pure pawn endgames)
-  if (depth >= 3 && !pos.isCheck() && ply > 0 && pos.hasNonPawnMaterial(pos.mSideToMove)) {
+  if (depth >= 3 && !inCheck && ply > 0 && pos.hasNonPawnMaterial(pos.mSideToMove)) {
     // Save current state
     int R = 2;  // Reduction amount (standard is 2, sometimes 3 for very high depth)
 
@@ -443,7 +372,7 @@ int Engine::negaMax(Position& pos, int depth, int alpha, int beta, std::stop_tok
 
     // Search with a "Null Window" and reduced depth
     // We pass -beta + 1 and -beta to verify if opponent can improve
-    int score = -negaMax(pos, depth - 1 - R, -beta, -beta + 1, stoken);
+    int score = -negaMax(th, depth - 1 - R, -beta, -beta + 1, stoken);
 
     pos.undoNullMove();  // Restore state
 
@@ -458,71 +387,56 @@ int Engine::negaMax(Position& pos, int depth, int alpha, int beta, std::stop_tok
     }
   }
 
-  MoveList moveList;
-  pos.getMoves(pos.mSideToMove, moveList);
-
-  // OPTIMIZATION: Better move ordering
-  for (int i = 0; i < moveList.count; i++) {
-    Move& m = moveList.moves[i];
-
-    // 1. TT move gets highest priority
-    if (ttMove.from != 0 && m.from == ttMove.from && m.to == ttMove.to) {
-      m.score = 2000000;
-    }
-    // 2. Winning captures (MVV-LVA)
-    else if (pos.board[m.to] != NOPIECE) {
-      int victim = pos.board[m.to];
-      int attacker = pos.board[m.from];
-      m.score = 1000000 + mvv_lva[victim][attacker];
-    }
-    // 3. Promotions
-    else if (m.promotion != NOPIECE) {
-      m.score = 900000 + pieceValues[m.promotion];
-    }
-    // 4. Killer moves
-    else if (ply >= 0 && ply < MAX_PLY) {
-      if (m.from == killerMoves[ply][0].from && m.to == killerMoves[ply][0].to) {
-        m.score = 800000;
-      } else if (m.from == killerMoves[ply][1].from && m.to == killerMoves[ply][1].to) {
-        m.score = 700000;
-      } else {
-        // 5. History heuristic
-        int mover = (pos.mSideToMove == WHITE) ? WHITE : BLACK;
-        m.score = historyMoves[mover][m.from][m.to];
-      }
-    } else {
-      int mover = (pos.mSideToMove == WHITE) ? WHITE : BLACK;
-      m.score = historyMoves[mover][m.from][m.to];
-    }
-  }
-
   int bestScore = -INF;
   Move bestMove = Move::null();
   int originalAlpha = alpha;
   int movesSearched = 0;
 
-  for (int i = 0; i < moveList.count; i++) {
-    pickMove(moveList, i);
+  // ABDADA: siblings another thread is already searching are pushed to the back
+  bool abdada = mSMPMode == SMPMode::ABDADA && mThreads.size() > 1 &&
+                depth >= ABDADA_MIN_DEPTH && ply < MAX_PLY;
+  Move* deferred = th.deferred[abdada ? ply : 0];
+  int deferredCount = 0;
+  int deferredNext = 0;
+
+  MovePicker picker(pos, ttMove, th.killerMoves[ply], th.historyMoves);
+  Move move;
+
+  while (true) {
+    bool isDeferred = false;
+    if (!picker.next(move)) {
+      if (deferredNext == deferredCount) break;
+      move = deferred[deferredNext++];
+      isDeferred = true;
+    }
 
-    bool isCapture = (pos.board[moveList.moves[i].to] != NOPIECE);
+    // Near the horizon a capture that loses material is not worth a search. The
+    // picker only describes the move it just returned, and a deferred move already
+    // passed this test on its first visit.
+    if (depth <= SEE_PRUNE_DEPTH && !inCheck && movesSearched > 0 && !isDeferred &&
+        picker.isBadCapture()) {
+      continue;
+    }
 
-    pos.doMove(moveList.moves[i]);
+    bool isCapture = (pos.board[move.to] != NOPIECE);
 
-    Color sideJustMoved = (pos.mSideToMove == WHITE) ? BLACK : WHITE;
-    int kingSquare = __builtin_ctzll(pos.pieces[sideJustMoved][KING]);
+    pos.doMove(move);
 
-    if (pos.isSquareAttacked(kingSquare, pos.mSideToMove)) {
-      pos.undoMove(moveList.moves[i]);
+    uint64_t childKey = pos.getHash();
+    if (abdada && !isDeferred && movesSearched > 0 && isBeingSearched(childKey)) {
+      pos.undoMove(move);
+      deferred[deferredCount++] = move;
       continue;
     }
 
     movesSearched++;
+    if (abdada) startSearching(childKey);
 
     int score;
 
     if (movesSearched == 1) {
       // 1. PV Move (First move): Search with full window
-      score = -negaMax(pos, depth - 1, -beta, -alpha, stoken);
+      score = -negaMax(th, depth - 1, -beta, -alpha, stoken);
     } else {
       // --- LATE MOVE REDUCTION (LMR) ---
       bool doReduction = false;
@@ -534,7 +448,7 @@ int Engine::negaMax(Position& pos, int depth, int alpha, int beta, std::stop_tok
       // 3. We have enough depth (depth >= 3)
       // 4. The move does NOT give check (!pos.isCheck())
       if (movesSearched >= 4 && depth >= 3 && !isCapture &&
-          moveList.moves[i].promotion == NOPIECE && !pos.isCheck() && !inCheck) {
+          move.promotion == NOPIECE && !pos.isCheck() && !inCheck) {
         doReduction = true;
 
         // Formula: Reduce by 1, or by 2 for very late moves
@@ -547,37 +461,38 @@ int Engine::negaMax(Position& pos, int depth, int alpha, int beta, std::stop_tok
 
       if (doReduction) {
         // Search with REDUCED depth and NULL window
-        score = -negaMax(pos, depth - 1 - reduction, -alpha - 1, -alpha, stoken);
+        score = -negaMax(th, depth - 1 - reduction, -alpha - 1, -alpha, stoken);
 
         if (score > alpha) {
-          score = -negaMax(pos, depth - 1, -alpha - 1, -alpha, stoken);
+          score = -negaMax(th, depth - 1, -alpha - 1, -alpha, stoken);
         }
 
       } else {
         // Hack to trigger full search below if we didn't reduce
-        score = -negaMax(pos, depth - 1, -alpha - 1, -alpha, stoken);
+        score = -negaMax(th, depth - 1, -alpha - 1, -alpha, stoken);
       }
 
       if (score > alpha && score < beta) {
-        score = -negaMax(pos, depth - 1, -beta, -alpha, stoken);
+        score = -negaMax(th, depth - 1, -beta, -alpha, stoken);
       }
     }
 
-    pos.undoMove(moveList.moves[i]);
+    pos.undoMove(move);
+    if (abdada) finishSearching(childKey);
 
     if (stoken.stop_requested()) return 0;
 
     if (score > bestScore) {
       bestScore = score;
-      bestMove = moveList.moves[i];
+      bestMove = move;
 
-      pvTable[ply][ply] = moveList.moves[i];
+      th.pvTable[ply][ply] = move;
 
-      for (int j = ply + 1; j < pvLength[ply + 1]; j++) {
-        pvTable[ply][j] = pvTable[ply + 1][j];
+      for (int j = ply + 1; j < th.pvLength[ply + 1]; j++) {
+        th.pvTable[ply][j] = th.pvTable[ply + 1][j];
       }
 
-      pvLength[ply] = (pvLength[ply + 1] > ply + 1) ? pvLength[ply + 1] : (ply + 1);
+      th.pvLength[ply] = (th.pvLength[ply + 1] > ply + 1) ? th.pvLength[ply + 1] : (ply + 1);
 
       if (score > alpha) {
         alpha = score;
@@ -586,37 +501,30 @@ int Engine::negaMax(Position& pos, int depth, int alpha, int beta, std::stop_tok
 
     if (alpha >= beta) {
       // Update history and killer moves for quiet moves
-      if (pos.board[moveList.moves[i].to] == NOPIECE) {
+      if (pos.board[move.to] == NOPIECE) {
         int mover = (pos.mSideToMove == WHITE) ? WHITE : BLACK;
-        int from = moveList.moves[i].from;
-        int to = moveList.moves[i].to;
+        int from = move.from;
+        int to = move.to;
 
         int bonus = depth * depth;
 
-        if (historyMoves[mover][from][to] < 5000) {
-          historyMoves[mover][from][to] += bonus;
+        if (th.historyMoves[mover][from][to] < 5000) {
+          th.historyMoves[mover][from][to] += bonus;
         }
 
         if (ply >= 0 && ply < MAX_PLY) {
-          killerMoves[ply][1] = killerMoves[ply][0];
-          killerMoves[ply][0] = moveList.moves[i];
+          th.killerMoves[ply][1] = th.killerMoves[ply][0];
+          th.killerMoves[ply][0] = move;
         }
       }
-      tt.store(pos.getHash(), depth, ply, beta, TT_BETA, moveList.moves[i]);
+      tt.store(pos.getHash(), depth, ply, beta, TT_BETA, move);
 
       return beta;
     }
   }
 
   if (movesSearched == 0) {
-    int kingSq = __builtin_ctzll(pos.pieces[pos.mSideToMove][KING]);
-
-    Color opponent = (pos.mSideToMove == WHITE) ? BLACK : WHITE;
-    if (pos.isSquareAttacked(kingSq, opponent)) {
-      return -INF + ply;
-    } else {
-      return 0;
-    }
+    return inCheck ? -INF + ply : 0;
   }
 
   TTFlag flag = TT_ALPHA;
@@ -629,15 +537,18 @@ int Engine::negaMax(Position& pos, int depth, int alpha, int beta, std::stop_tok
   return bestScore;
 }
 
-Move Engine::search(Position& pos, int timeLimitMs, std::stop_token stoken) {
-  mStartTime = std::chrono::steady_clock::now();
-  mTimeAllocated = timeLimitMs;
-  mStop = false;
+void SearchThread::clear() {
   nodes = 0;
-
-  mLastBestMove = Move::null();
-  mCurrentEval = 0;
-  mCurrentDepth = 1;
+  rootDepth = 0;
+  completedDepth = 0;
+  researches = 0;
+  pawnTable.probes = 0;
+  pawnTable.hits = 0;
+  tbHits = 0;
+  pvIdx = 0;
+  rootMoves.clear();
+  bestScore = 0;
+  bestMove = Move::null();
 
   for (int c = 0; c < 2; c++) {
     for (int f = 0; f < 64; f++) {
@@ -647,32 +558,277 @@ Move Engine::search(Position& pos, int timeLimitMs, std::stop_token stoken) {
     }
   }
 
-  for (int i = 0; i < MAX_PLY; i++) {
+  for (int i = 0; i < Engine::MAX_PLY; i++) {
     killerMoves[i][0] = Move::null();
     killerMoves[i][1] = Move::null();
+    pvLength[i] = 0;
+    pvTable[0][i] = Move::null();
   }
+}
 
-  for (int depth = 1; depth <= mDepth; depth++) {
-    int score = negaMax(pos, mCurrentDepth, -INF, INF, stoken);
+uint64_t Engine::totalNodes() const {
+  uint64_t total = 0;
+  for (const auto& th : mThreads) {
+    total += th->nodes.load(std::memory_order_relaxed);
+  }
+  return total;
+}
 
-    if (mStop || stoken.stop_requested()) {
-      break;
+long long Engine::elapsedMs() const {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() -
+                                                               mStartTime)
+      .count();
+}
+
+int Engine::searchRoot(SearchThread& th, int depth, int alpha, int beta,
+                       std::stop_token& stoken) {
+  Position& pos = th.pos;
+  th.pvLength[0] = 0;
+
+  int bestScore = -INF;
+  int originalAlpha = alpha;
+  Move bestMove = Move::null();
+
+  // Lines above pvIdx are already reported this iteration and stay out of the search
+  for (size_t i = th.pvIdx; i < th.rootMoves.size(); i++) {
+    RootMove& rm = th.rootMoves[i];
+    uint64_t nodesBefore = th.nodes.load(std::memory_order_relaxed);
+
+    pos.doMove(rm.move);
+
+    int score;
+    if (i == (size_t)th.pvIdx) {
+      score = -negaMax(th, depth - 1, -beta, -alpha, stoken);
+    } else {
+      // PVS: prove the move is worse with a null window, re-search only if it is not
+      score = -negaMax(th, depth - 1, -alpha - 1, -alpha, stoken);
+      if (score > alpha && score < beta) {
+        score = -negaMax(th, depth - 1, -beta, -alpha, stoken);
+      }
+    }
+
+    pos.undoMove(rm.move);
+
+    rm.nodes = th.nodes.load(std::memory_order_relaxed) - nodesBefore;
+
+    if (mStop || stoken.stop_requested()) return 0;
+
+    if (i == (size_t)th.pvIdx || score > alpha) {
+      rm.score = score;
+      rm.pv.assign(1, rm.move);
+      for (int j = 1; j < th.pvLength[1]; j++) rm.pv.push_back(th.pvTable[1][j]);
+    } else {
+      // Only an upper bound: sorts below every move with a real score
+      rm.score = -INF;
+    }
+
+    if (score > bestScore) {
+      bestScore = score;
+      bestMove = rm.move;
     }
+    if (score > alpha) alpha = score;
+    if (alpha >= beta) break;
+  }
+
+  if (th.pvIdx == 0 && (bestMove.from != 0 || bestMove.to != 0)) {
+    TTFlag flag = bestScore >= beta ? TT_BETA : (bestScore > originalAlpha ? TT_EXACT : TT_ALPHA);
+    tt.store(pos.getHash(), depth, 0, bestScore, flag, bestMove);
+  }
+
+  return bestScore;
+}
 
-    std::vector<Move> pvLine = getPV(pos, depth);
+void Engine::reportIteration(SearchThread& th, int depth, int multiPV) {
+  long long elapsed = elapsedMs();
+  uint64_t nodes = totalNodes();
+  uint64_t nps = elapsed > 0 ? nodes * 1000 / elapsed : nodes;
 
-    std::cout << "info depth " << depth << " score cp " << score << " nodes " << nodes << " pv";
+  for (int k = 0; k < multiPV; k++) {
+    RootMove& rm = th.rootMoves[k];
+    // TT cutoffs inside the PV truncate the tracked line; finish it from the TT
+    extendPV(th.pos, rm.pv, depth);
 
-    for (const Move& m : pvLine) {
+    std::cout << "info depth " << depth << " multipv " << k + 1 << " score cp " << rm.score
+              << " nodes " << nodes << " time " << elapsed << " nps " << nps << " pv";
+
+    for (const Move& m : rm.pv) {
       std::cout << " " << util::moveToString(m);
     }
     std::cout << std::endl;
+  }
+}
+
+void Engine::iterativeDeepening(SearchThread& th, std::stop_token stoken) {
+  if (th.rootMoves.empty()) return;
+
+  // Helpers only feed the TT; extra lines are the main thread's job
+  int multiPV = th.id == 0 ? std::min<int>(mMultiPV, th.rootMoves.size()) : 1;
+
+  auto byScoreThenNodes = [](const RootMove& a, const RootMove& b) {
+    return a.score != b.score ? a.score > b.score : a.nodes > b.nodes;
+  };
+
+  for (int depth = 1; depth <= mSearchDepth; depth++) {
+    long long iterationStart = elapsedMs();
+
+    // Lazy SMP: odd helpers run one ply ahead so the threads do not all walk the same tree.
+    // ABDADA keeps everyone on the same depth and splits the work through deferral instead.
+    bool skipAhead = mSMPMode == SMPMode::LazySMP && (th.id & 1);
+    th.rootDepth = skipAhead ? std::min(depth + 1, mSearchDepth) : depth;
+
+    for (RootMove& rm : th.rootMoves) rm.previousScore = rm.score;
+
+    for (th.pvIdx = 0; th.pvIdx < multiPV; th.pvIdx++) {
+      // Aspiration window around this line's previous score, widened on every fail until
+      // the score lands inside it
+      int previous = th.rootMoves[th.pvIdx].previousScore;
+      int delta = ASPIRATION_WINDOW;
+      int alpha = -INF;
+      int beta = INF;
+      if (th.rootDepth >= ASPIRATION_MIN_DEPTH && previous > -INF) {
+        alpha = std::max(previous - delta, -INF);
+        beta = std::min(previous + delta, INF);
+      }
+
+      while (true) {
+        int score = searchRoot(th, th.rootDepth, alpha, beta, stoken);
+
+        if (mStop || stoken.stop_requested()) break;
+
+        // Best lines first; moves that only got a bound go by subtree size
+        std::stable_sort(th.rootMoves.begin() + th.pvIdx, th.rootMoves.end(), byScoreThenNodes);
+
+        bool failLow = score <= alpha;
+        if (failLow) {
+          beta = (alpha + beta) / 2;
+          alpha = std::max(score - delta, -INF);
+        } else if (score >= beta) {
+          beta = std::min(score + delta, INF);
+        } else {
+          break;
+        }
+
+        th.researches++;
+        delta += delta / 2;
+
+        if (th.id == 0) {
+          std::cout << "info depth " << depth << " multipv " << th.pvIdx + 1 << " score cp "
+                    << score << (failLow ? " upperbound" : " lowerbound") << " nodes "
+                    << totalNodes() << " time " << elapsedMs() << std::endl;
+        }
+      }
+
+      if (mStop || stoken.stop_requested()) break;
+
+      std::stable_sort(th.rootMoves.begin(), th.rootMoves.begin() + th.pvIdx + 1,
+                       byScoreThenNodes);
+    }
+
+    if (mStop || stoken.stop_requested()) {
+      break;
+    }
+
+    Move previousBest = th.bestMove;
+    int previousScore = th.bestScore;
+
+    th.completedDepth = th.rootDepth;
+    th.bestScore = th.rootMoves[0].score;
+    th.bestMove = th.rootMoves[0].move;
+
+    // Only the main thread reports
+    if (th.id != 0) continue;
+
+    mCurrentDepth = depth;
+    mCurrentEval = th.bestScore;
+
+    reportIteration(th, depth, multiPV);
+
+    const std::vector<Move>& pv = th.rootMoves[0].pv;
+    mLastBestMove = th.bestMove;
+    mPonderMove = pv.size() > 1 ? pv[1] : Move::null();
+
+    // Spend more on unstable or worsening positions, less when the best move holds
+    if (depth > 1) {
+      bool bestMoveChanged =
+          previousBest.from != th.bestMove.from || previousBest.to != th.bestMove.to;
+      mTime.update(bestMoveChanged, previousScore - th.bestScore);
+    }
+
+    if (!mPondering && !mTime.canStartIteration(elapsedMs() - iterationStart)) break;
+  }
+}
+
+Move Engine::search(Position& pos, const SearchLimits& limits, std::stop_token stoken) {
+  mStartTime = std::chrono::steady_clock::now();
+  mTime.init(limits, pos.mSideToMove, mMoveOverhead);
+  mSearchDepth = limits.depth > 0 ? std::min(limits.depth, MAX_PLY - 1) : mDepth;
+  mStop = false;
+  mPondering = limits.ponder;
+
+  mLastBestMove = Move::null();
+  mPonderMove = Move::null();
+  mCurrentEval = 0;
+  mCurrentDepth = 1;
+
+  // The root move list is built once and shared out; each thread keeps its own order
+  std::vector<RootMove> rootMoves;
+  MoveList moveList;
+  pos.getMoves(moveList);
+  for (int i = 0; i < moveList.count; i++) rootMoves.emplace_back(moveList.moves[i]);
 
-    // Only update if we have a valid PV
-    if (!pvLine.empty()) {
-      mLastBestMove = pvLine[0];
+  // The network may have been loaded after the position was set up
+  if (nnue::isLoaded()) pos.refreshAccumulator();
+
+  for (auto& th : mThreads) {
+    th->clear();
+    th->pos = pos;
+    th->rootPly = pos.gamePly;
+    th->rootMoves = rootMoves;
+  }
+
+  if (mSMPMode == SMPMode::ABDADA) {
+    for (auto& slot : mSearching) slot.store(0, std::memory_order_relaxed);
+  }
+
+  {
+    std::vector<std::jthread> helpers;
+    for (size_t i = 1; i < mThreads.size(); i++) {
+      helpers.emplace_back(
+          [this, &th = *mThreads[i], stoken]() { iterativeDeepening(th, stoken); });
     }
-    mCurrentDepth++;
+
+    iterativeDeepening(*mThreads[0], stoken);
+
+    // Main thread is done (time, depth or stop): bring the helpers down with it
+    mStop = true;
+  }
+
+  int researches = 0;
+  uint64_t pawnProbes = 0, pawnHits = 0, tbHits = 0;
+  for (const auto& th : mThreads) {
+    researches += th->researches;
+    tbHits += th->tbHits;
+    pawnProbes += th->pawnTable.probes;
+    pawnHits += th->pawnTable.hits;
+  }
+  std::cout << "info string aspiration researches " << researches << std::endl;
+  if (pawnProbes > 0) {
+    std::cout << "info string pawn hash hits " << pawnHits * 100 / pawnProbes << "% ("
+              << pawnProbes << " probes)" << std::endl;
+  }
+  if (tbHits > 0) std::cout << "info string tablebase hits " << tbHits << std::endl;
+
+  // Vote: the deepest completed iteration wins, ties go to the higher score
+  const SearchThread* best = mThreads[0].get();
+  for (const auto& th : mThreads) {
+    if (th->bestMove.from == 0 && th->bestMove.to == 0) continue;
+    if (th->completedDepth > best->completedDepth ||
+        (th->completedDepth == best->completedDepth && th->bestScore > best->bestScore)) {
+      best = th.get();
+    }
+  }
+  if (best->bestMove.from != 0 || best->bestMove.to != 0) {
+    mLastBestMove = best->bestMove;
   }
 
   // Safety check: ensure we have a valid legal move
@@ -680,7 +836,7 @@ Move Engine::search(Position& pos, int timeLimitMs, std::stop_token stoken) {
   if (mLastBestMove.from != 0 || mLastBestMove.to != 0) {
     // Check if this move is actually legal
     MoveList moveList;
-    pos.getMoves(pos.mSideToMove, moveList);
+    pos.getMoves(moveList);
     for (int i = 0; i < moveList.count; i++) {
       if (moveList.moves[i].from == mLastBestMove.from &&
           moveList.moves[i].to == mLastBestMove.to &&
@@ -694,7 +850,7 @@ Move Engine::search(Position& pos, int timeLimitMs, std::stop_token stoken) {
   if (!moveIsValid) {
     // No valid move found, generate any legal move
     MoveList moveList;
-    pos.getMoves(pos.mSideToMove, moveList);
+    pos.getMoves(moveList);
     if (moveList.count > 0) {
       mLastBestMove = moveList.moves[0];
     } else {
@@ -703,55 +859,145 @@ Move Engine::search(Position& pos, int timeLimitMs, std::stop_token stoken) {
     }
   }
 
-  std::cout << "bestmove " << util::moveToString(mLastBestMove) << std::endl;
+  // A ponder or infinite search may run out of depth before the GUI is done with it;
+  // UCI forbids sending bestmove until we get ponderhit or stop
+  while ((mPondering || limits.infinite) && !stoken.stop_requested()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  // Ponder on the reply from the reported PV; if another thread's move won the vote,
+  // fall back to the TT for the expected reply
+  const Move& mainBest = mThreads[0]->bestMove;
+  bool fromMainPV = mainBest.from == mLastBestMove.from && mainBest.to == mLastBestMove.to &&
+                    mainBest.promotion == mLastBestMove.promotion;
+  if (!moveIsValid || !fromMainPV) mPonderMove = Move::null();
+  if (moveIsValid && !fromMainPV) {
+    std::vector<Move> pv{mLastBestMove};
+    extendPV(pos, pv, 2);
+    if (pv.size() > 1) mPonderMove = pv[1];
+  }
+
+  std::cout << "bestmove " << util::moveToString(mLastBestMove);
+  if (mPonderMove.from != 0 || mPonderMove.to != 0) {
+    std::cout << " ponder " << util::moveToString(mPonderMove);
+  }
+  std::cout << std::endl;
 
   return mLastBestMove;
 }
 
-int Engine::evaluate(Position& pos) {
-  // Get current state
-  StateInfo& st = pos.history[pos.gamePly];
+int Engine::evaluate(SearchThread& th) {
+  Position& pos = th.pos;
+
+  // Transpositions and re-searches keep revisiting the same positions
+  int cached;
+  if (evalHash.probe(pos.mHash, cached)) return cached;
+
+  // Known endgames have their own evaluation, trusted over the network
+  MaterialEntry* material = th.materialTable.probe(pos);
+  if (material->evaluationFn) {
+    int score = material->evaluationFn(pos, material->strongSide);
+    score = (pos.mSideToMove == material->strongSide) ? score : -score;
+    evalHash.store(pos.mHash, score);
+    return score;
+  }
+
+  if (nnue::isLoaded()) {
+    int score = nnue::evaluate(pos.mAccumulator, pos.mSideToMove);
+    evalHash.store(pos.mHash, score);
+    return score;
+  }
 
   // Material + PSQT is already incremental via pos.posEval.positionScore
-  int score = pos.posEval.positionScore;
-
-  // Check if we have cached evaluation components
-  if (!st.evalCache.valid) {
-    // Compute and cache all evaluation components
-    st.evalCache.pawnScore[WHITE] = evalPawns(pos, WHITE);
-    st.evalCache.pawnScore[BLACK] = evalPawns(pos, BLACK);
-    st.evalCache.safetyScore[WHITE] = evalKingSafety(pos, WHITE);
-    st.evalCache.safetyScore[BLACK] = evalKingSafety(pos, BLACK);
-    st.evalCache.mobilityScore[WHITE] = evalPieces(pos, WHITE);
-    st.evalCache.mobilityScore[BLACK] = evalPieces(pos, BLACK);
-    st.evalCache.valid = true;
-  }
-
-  // Use cached values
-  score += (st.evalCache.pawnScore[WHITE] - st.evalCache.pawnScore[BLACK]);
-  score += (st.evalCache.safetyScore[WHITE] - st.evalCache.safetyScore[BLACK]);
-  score += (st.evalCache.mobilityScore[WHITE] - st.evalCache.mobilityScore[BLACK]);
-
-  return (pos.mSideToMove == WHITE) ? score : -score;
+  int score = pos.posEval.positionScore + material->imbalance;
+
+  // Pawn structure and king shelter only change with the pawns
+  bool found;
+  PawnEntry* entry = th.pawnTable.probe(pos.mPawnKey, found);
+  if (!found) {
+    evalPawns(pos, WHITE, *entry);
+    evalPawns(pos, BLACK, *entry);
+    entry->key = pos.mPawnKey;
+  }
+
+  score += (entry->score[WHITE] - entry->score[BLACK]);
+  // King shelter fades out as pieces come off
+  int safety = evalKingSafety(pos, WHITE, *entry) - evalKingSafety(pos, BLACK, *entry);
+  score += safety * material->phase / PHASE_MIDGAME;
+  score += (evalPieces(pos, WHITE) - evalPieces(pos, BLACK));
+
+  // Drawish material (no pawns and too little extra, wrong bishop, ...)
+  score = score * material->scaleFactor(pos, score > 0 ? WHITE : BLACK) / SCALE_NORMAL;
+
+  score = (pos.mSideToMove == WHITE) ? score : -score;
+  evalHash.store(pos.mHash, score);
+  return score;
+}
+
+void Engine::ponderhit() {
+  // Time spent pondering was the opponent's; the clock starts counting now
+  mTime.ponderhit();
+  mPondering = false;
 }
 
 void Engine::setDepth(int depth) { mDepth = depth; }
 
 int Engine::getDepth() { return mDepth; }
 
-Engine::Engine() : tt(64) {
+void Engine::setMoveOverhead(int ms) { mMoveOverhead = std::max(0, ms); }
+
+void Engine::setMultiPV(int lines) { mMultiPV = std::max(1, lines); }
+
+void Engine::setThreads(int threads) {
+  threads = std::clamp(threads, 1, MAX_THREADS);
+
+  mThreads.resize(threads);
+  for (int i = 0; i < threads; i++) {
+    if (!mThreads[i]) {
+      mThreads[i] = std::make_unique<SearchThread>();
+      mThreads[i]->id = i;
+      mThreads[i]->clear();
+    }
+  }
+}
+
+int Engine::getThreads() const { return (int)mThreads.size(); }
+
+void Engine::setSMPMode(SMPMode mode) { mSMPMode = mode; }
+
+SMPMode Engine::getSMPMode() const { return mSMPMode; }
+
+bool Engine::isBeingSearched(uint64_t key) const {
+  return mSearching[key & (ABDADA_TABLE_SIZE - 1)].load(std::memory_order_relaxed) == key;
+}
+
+void Engine::startSearching(uint64_t key) {
+  mSearching[key & (ABDADA_TABLE_SIZE - 1)].store(key, std::memory_order_relaxed);
+}
+
+void Engine::finishSearching(uint64_t key) {
+  std::atomic<uint64_t>& slot = mSearching[key & (ABDADA_TABLE_SIZE - 1)];
+  // Another thread may have claimed the slot since; only clear our own marker
+  if (slot.load(std::memory_order_relaxed) == key) slot.store(0, std::memory_order_relaxed);
+}
+
+Engine::Engine() : tt(TranspositionTable::DEFAULT_SIZE_MB), evalHash(EvalHash::DEFAULT_SIZE_MB) {
   mCurrentDepth = 0;
   mCurrentEval = 0;
   mDepth = 30;
+  mSearchDepth = mDepth;
+  mMoveOverhead = DEFAULT_MOVE_OVERHEAD;
+  mMultiPV = 1;
   mTimeSpentMs = 0;
+  mStop = false;
+  mPondering = false;
+  mSMPMode = SMPMode::LazySMP;
 
-  // Initialize PV table
-  for (int i = 0; i < MAX_PLY; i++) {
-    pvLength[i] = 0;
-    for (int j = 0; j < MAX_PLY; j++) {
-      pvTable[i][j] = Move::null();
-    }
-  }
+  initEvalMasks();
+
+  for (auto& slot : mSearching) slot.store(0, std::memory_order_relaxed);
+
+  setThreads(1);
 }
 
 Engine::~Engine() {}
@@ -0,0 +1,18 @@
+#include "../include/evalHash.hpp"
+
+EvalHash::EvalHash(int sizeInMB) { resize(sizeInMB); }
+
+void EvalHash::resize(int sizeInMB) {
+  size_t target = (size_t)sizeInMB * 1024 * 1024 / sizeof(uint64_t);
+
+  size_t slots = 1;
+  while (slots * 2 <= target) slots *= 2;
+
+  mSlots = std::make_unique<std::atomic<uint64_t>[]>(slots);
+  mMask = slots - 1;
+  clear();
+}
+
+void EvalHash::clear() {
+  for (uint64_t i = 0; i <= mMask; i++) mSlots[i].store(0, std::memory_order_relaxed);
+}
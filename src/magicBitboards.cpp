@@ -1,185 +1,254 @@
 #include "../include/magicBitboards.hpp"
 
-#include <cstring>
+#include <sys/mman.h>
 
-Magic rookMagics[64];
-Magic bishopMagics[64];
+#if defined(__x86_64__)
+#include <cpuid.h>
+#include <immintrin.h>
+#define HAS_PEXT 1
+// Built without BMI2 enabled (no -march=native on a BMI2 host): compile the PEXT
+// lookups for BMI2 anyway and only call them once CPUID says they will run
+#if defined(__BMI2__)
+#define PEXT_TARGET
+#else
+#define PEXT_TARGET __attribute__((target("bmi2")))
+#endif
+#endif
 
-// Huge array to store all precomputed attacks (~2.3 MB)
-// Rooks need 4096 per square (12 bits), Bishops need fewer.
-Bitboard rookAttackTable[64 * 4096];
-Bitboard bishopAttackTable[64 * 512];
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <vector>
 
-// 1. Random Number Generator for finding Magics
-uint64_t random_u64() {
-  static uint64_t seed = 1804289383;
-  // XORShift algorithm for fast pseudo-random numbers
-  seed ^= seed << 13;
-  seed ^= seed >> 7;
-  seed ^= seed << 17;
-  return seed;
-}
+namespace {
+
+// Found once by random trial and error, each for a shift of exactly popcount(mask), so
+// square s only needs 2^popcount(mask) table entries
+constexpr Bitboard ROOK_MAGICS[64] = {
+    0xA080004000201880ULL, 0x0840100040002000ULL, 0x1E800C2000100080ULL,
+    0x1080048010000802ULL, 0x0100100800040300ULL, 0x020003100C086200ULL,
+    0x040016B012041308ULL, 0x420002004183002CULL, 0x0180800080400020ULL,
+    0x0102401004200040ULL, 0x1012002010420080ULL, 0x2102002190C00A00ULL,
+    0x802A001009042200ULL, 0x0202000891040200ULL, 0x0010802100220080ULL,
+    0x0801000040810002ULL, 0x0040208000804000ULL, 0x0230104000200041ULL,
+    0x0000888020031000ULL, 0x0250008080080010ULL, 0x2202050011010800ULL,
+    0x0001010008040002ULL, 0x0003040002080110ULL, 0x1000020010408124ULL,
+    0x0010800080204008ULL, 0x8060002040005000ULL, 0x6001024300102001ULL,
+    0x0040100080080084ULL, 0x1024040080080280ULL, 0x8804020080040080ULL,
+    0x5042004200085144ULL, 0x2010C08200004421ULL, 0x0000400028800082ULL,
+    0x0000882004804000ULL, 0x8010002800200401ULL, 0x4000801000800804ULL,
+    0x0444800800800400ULL, 0x0002002004040010ULL, 0x90C8100144000802ULL,
+    0x1002084902000084ULL, 0x0DC0802040008000ULL, 0x4010002000404001ULL,
+    0x28200100E0450030ULL, 0x0010010010210008ULL, 0x0200080004008080ULL,
+    0x0E24000200048080ULL, 0x8000210802A40030ULL, 0x20A0010040820004ULL,
+    0x0000204080010100ULL, 0x8020200098400180ULL, 0x4000200080100880ULL,
+    0x9100080010008080ULL, 0x0004040080080080ULL, 0x00BA001400800280ULL,
+    0x7002000144084200ULL, 0x4240800100004080ULL, 0x000300800A102041ULL,
+    0x000D020440208012ULL, 0x00C04058A0010013ULL, 0x0011001000060821ULL,
+    0x0011000800020411ULL, 0x4082001004810802ULL, 0x0000080082011004ULL,
+    0x1011CC0100205082ULL,
+};
 
-// Generate a candidate magic number (sparse, few 1s)
-uint64_t random_u64_fewbits() { return random_u64() & random_u64() & random_u64(); }
+constexpr Bitboard BISHOP_MAGICS[64] = {
+    0x002819430C040184ULL, 0x0420024204590010ULL, 0x2010040842520080ULL,
+    0x2209040104200000ULL, 0x0002021020800000ULL, 0x4D02161220010020ULL,
+    0x0A01040220040000ULL, 0x0060108401084030ULL, 0x1000400302020200ULL,
+    0x1000200224190020ULL, 0x8022B10802810000ULL, 0x0008040400895040ULL,
+    0x802087104000C840ULL, 0x0204510108410320ULL, 0x002001040202C000ULL,
+    0x0010028041182034ULL, 0x00104440300210C4ULL, 0x1008280242241400ULL,
+    0x04A8049012E44050ULL, 0x8484001814200800ULL, 0xA324011880E00000ULL,
+    0x0101040201008202ULL, 0x8801100208904400ULL, 0xA200200041041014ULL,
+    0x2158410404050800ULL, 0x1042020008100440ULL, 0x0000280004104400ULL,
+    0x0001080004004250ULL, 0x0009001005004008ULL, 0x81228200A1011480ULL,
+    0x120510504A180C00ULL, 0x08008020C9040240ULL, 0x4150045210041002ULL,
+    0x1181012080088823ULL, 0x000C210100100400ULL, 0x4508020080080080ULL,
+    0x0844040400801010ULL, 0x2050004040020100ULL, 0x0090008081411442ULL,
+    0x0084404200004100ULL, 0x0004500411050404ULL, 0x0011009010408505ULL,
+    0x0202020201084200ULL, 0x0040286018000100ULL, 0x0840080104040040ULL,
+    0x8040100048C00180ULL, 0x0084010404008908ULL, 0x0002020049088A02ULL,
+    0x0804041282502420ULL, 0x0003884822108040ULL, 0x0142170049100001ULL,
+    0x000B001820882010ULL, 0xA811001120220028ULL, 0x0028088208820001ULL,
+    0x10100411480A0018ULL, 0x0118900404414500ULL, 0x0009002104200415ULL,
+    0x0401018448480401ULL, 0x8220000304052400ULL, 0x0000040008208802ULL,
+    0x0280000804208200ULL, 0x0440040409700100ULL, 0x4040045102021406ULL,
+    0x2002200212020021ULL,
+};
 
-// 2. Slow/Standard Attack Generation (used only for validation)
-Bitboard get_rook_mask(int sq) {
+// Rays from 'sq' in the four rook or bishop directions, stopping at the first blocker
+constexpr Bitboard slidingAttacks(int sq, Bitboard block, bool bishop) {
+  constexpr int ROOK_STEPS[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+  constexpr int BISHOP_STEPS[4][2] = {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
   Bitboard attacks = 0;
-  int r = sq / 8, f = sq % 8;
-  for (int r2 = r + 1; r2 <= 6; r2++) attacks |= (1ULL << (r2 * 8 + f));
-  for (int r2 = r - 1; r2 >= 1; r2--) attacks |= (1ULL << (r2 * 8 + f));
-  for (int f2 = f + 1; f2 <= 6; f2++) attacks |= (1ULL << (r * 8 + f2));
-  for (int f2 = f - 1; f2 >= 1; f2--) attacks |= (1ULL << (r * 8 + f2));
+  for (const auto& step : bishop ? BISHOP_STEPS : ROOK_STEPS) {
+    int r = sq / 8 + step[0], f = sq % 8 + step[1];
+    for (; r >= 0 && r <= 7 && f >= 0 && f <= 7; r += step[0], f += step[1]) {
+      attacks |= 1ULL << (r * 8 + f);
+      if (block & (1ULL << (r * 8 + f))) break;
+    }
+  }
   return attacks;
 }
 
-Bitboard get_bishop_mask(int sq) {
-  Bitboard attacks = 0;
-  int r = sq / 8, f = sq % 8;
-  for (int r2 = r + 1, f2 = f + 1; r2 <= 6 && f2 <= 6; r2++, f2++)
-    attacks |= (1ULL << (r2 * 8 + f2));
-  for (int r2 = r + 1, f2 = f - 1; r2 <= 6 && f2 >= 1; r2++, f2--)
-    attacks |= (1ULL << (r2 * 8 + f2));
-  for (int r2 = r - 1, f2 = f + 1; r2 >= 1 && f2 <= 6; r2--, f2++)
-    attacks |= (1ULL << (r2 * 8 + f2));
-  for (int r2 = r - 1, f2 = f - 1; r2 >= 1 && f2 >= 1; r2--, f2--)
-    attacks |= (1ULL << (r2 * 8 + f2));
-  return attacks;
+// Squares whose occupancy matters: the empty-board attacks minus the board edges
+// (a blocker on the last square of a ray changes nothing)
+constexpr Bitboard relevantMask(int sq, bool bishop) {
+  constexpr Bitboard RANK_EDGES = 0xFF000000000000FFULL, FILE_EDGES = 0x8181818181818181ULL;
+  Bitboard edges = (RANK_EDGES & ~(0xFFULL << (sq / 8 * 8))) |
+                   (FILE_EDGES & ~(0x0101010101010101ULL << (sq % 8)));
+  return slidingAttacks(sq, 0, bishop) & ~edges;
 }
 
-Bitboard rook_attacks_slow(int sq, Bitboard block) {
-  Bitboard attacks = 0;
-  int r = sq / 8, f = sq % 8;
-  for (int r2 = r + 1; r2 <= 7; r2++) {
-    attacks |= (1ULL << (r2 * 8 + f));
-    if (block & (1ULL << (r2 * 8 + f))) break;
-  }
-  for (int r2 = r - 1; r2 >= 0; r2--) {
-    attacks |= (1ULL << (r2 * 8 + f));
-    if (block & (1ULL << (r2 * 8 + f))) break;
-  }
-  for (int f2 = f + 1; f2 <= 7; f2++) {
-    attacks |= (1ULL << (r * 8 + f2));
-    if (block & (1ULL << (r * 8 + f2))) break;
-  }
-  for (int f2 = f - 1; f2 >= 0; f2--) {
-    attacks |= (1ULL << (r * 8 + f2));
-    if (block & (1ULL << (r * 8 + f2))) break;
-  }
-  return attacks;
+constexpr size_t entries(int sq, bool bishop) {
+  return 1ULL << __builtin_popcountll(relevantMask(sq, bishop));
 }
 
-Bitboard bishop_attacks_slow(int sq, Bitboard block) {
-  Bitboard attacks = 0;
-  int r = sq / 8, f = sq % 8;
-  for (int r2 = r + 1, f2 = f + 1; r2 <= 7 && f2 <= 7; r2++, f2++) {
-    attacks |= (1ULL << (r2 * 8 + f2));
-    if (block & (1ULL << (r2 * 8 + f2))) break;
-  }
-  for (int r2 = r + 1, f2 = f - 1; r2 <= 7 && f2 >= 0; r2++, f2--) {
-    attacks |= (1ULL << (r2 * 8 + f2));
-    if (block & (1ULL << (r2 * 8 + f2))) break;
-  }
-  for (int r2 = r - 1, f2 = f + 1; r2 >= 0 && f2 <= 7; r2--, f2++) {
-    attacks |= (1ULL << (r2 * 8 + f2));
-    if (block & (1ULL << (r2 * 8 + f2))) break;
-  }
-  for (int r2 = r - 1, f2 = f - 1; r2 >= 0 && f2 >= 0; r2--, f2--) {
-    attacks |= (1ULL << (r2 * 8 + f2));
-    if (block & (1ULL << (r2 * 8 + f2))) break;
+constexpr size_t ROOK_ENTRIES = [] {
+  size_t total = 0;
+  for (int sq = 0; sq < 64; sq++) total += entries(sq, false);
+  return total;
+}();
+
+constexpr size_t TABLE_ENTRIES = [] {
+  size_t total = ROOK_ENTRIES;
+  for (int sq = 0; sq < 64; sq++) total += entries(sq, true);
+  return total;
+}();
+
+constexpr size_t HUGE_PAGE = 2 * 1024 * 1024;
+constexpr size_t TABLE_BYTES =
+    (TABLE_ENTRIES * sizeof(Bitboard) + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+static_assert(ROOK_ENTRIES == 102400 && TABLE_ENTRIES == 107648);
+
+}  // namespace
+
+// Every square's attacks, packed back to back: the rooks' 102400 entries, then the
+// bishops' 5248 (~840 KB). Each square's slice is 2^popcount(mask) entries, at least
+// 256 bytes, so every slice starts on a cache line. Aligned and padded to one huge page.
+alignas(HUGE_PAGE) Bitboard attackTable[TABLE_BYTES / sizeof(Bitboard)];
+
+namespace {
+
+constexpr std::array<Magic, 64> makeMagics(bool bishop) {
+  std::array<Magic, 64> magics{};
+  size_t offset = bishop ? ROOK_ENTRIES : 0;
+  for (int sq = 0; sq < 64; sq++) {
+    Magic& m = magics[sq];
+    m.mask = relevantMask(sq, bishop);
+    m.magic = bishop ? BISHOP_MAGICS[sq] : ROOK_MAGICS[sq];
+    m.shift = 64 - __builtin_popcountll(m.mask);
+    m.attacks = &attackTable[offset];
+    offset += entries(sq, bishop);
   }
-  return attacks;
+  return magics;
 }
 
-int count_1s(Bitboard b) {
-  int r = 0;
-  while (b) {
-    r++;
-    b &= b - 1;
-  }
-  return r;
-}
-
-// This performs the "Magic": (Blockers & Mask) * Magic >> Shift
-int transform(Bitboard b, uint64_t magic, int bits) { return (int)((b * magic) >> (64 - bits)); }
-
-// This function loops until it finds a magic number that works for a specific square
-void find_magic(int sq, int m, int bishop) {
-  Bitboard mask = bishop ? get_bishop_mask(sq) : get_rook_mask(sq);
-  int blockBits = count_1s(mask);
-  int var = 1 << blockBits;  // Number of blocker variations
-
-  // Arrays to store test data
-  Bitboard blockers[4096];
-  Bitboard attacks[4096];
-  Bitboard used[4096];
-
-  // Precompute all blocker/attack pairs for this square
-  for (int i = 0; i < var; i++) {
-    blockers[i] = 0;
-    Bitboard tempMask = mask;
-    // Map index 'i' to a blocker bitboard
-    for (int bit = 0; bit < blockBits; bit++) {
-      int lsb = __builtin_ctzll(tempMask);  // Get least significant bit index
-      tempMask &= tempMask - 1;             // Clear LSB
-      if (i & (1 << bit)) blockers[i] |= (1ULL << lsb);
-    }
-    attacks[i] = bishop ? bishop_attacks_slow(sq, blockers[i]) : rook_attacks_slow(sq, blockers[i]);
-  }
+}  // namespace
 
-  // Trial and Error Loop
-  for (int k = 0; k < 100000000; k++) {
-    uint64_t magic = random_u64_fewbits();
+constinit std::array<Magic, 64> rookMagics = makeMagics(false);
+constinit std::array<Magic, 64> bishopMagics = makeMagics(true);
 
-    // This check is a heuristic to reject obviously bad magics quickly
-    if (count_1s((mask * magic) & 0xFF00000000000000ULL) < 6) continue;
+namespace {
 
-    // Verify the magic
-    memset(used, 0, sizeof(used));
-    bool fail = false;
+SliderBackend activeBackend = SliderBackend::Magic;
 
-    for (int i = 0; i < var; i++) {
-      int index = transform(blockers[i], magic, blockBits);
+#ifdef HAS_PEXT
+PEXT_TARGET inline Bitboard pextIndex(Bitboard occupancy, Bitboard mask) {
+  return _pext_u64(occupancy, mask);
+}
 
-      if (used[index] == 0) {
-        used[index] = attacks[i];
-      } else if (used[index] != attacks[i]) {
-        fail = true;  // Collision! Two different attacks map to same index
-        break;
-      }
-    }
+PEXT_TARGET Bitboard pextRookAttacks(int square, Bitboard occupancy) {
+  const Magic& m = rookMagics[square];
+  return m.attacks[pextIndex(occupancy, m.mask)];
+}
+
+PEXT_TARGET Bitboard pextBishopAttacks(int square, Bitboard occupancy) {
+  const Magic& m = bishopMagics[square];
+  return m.attacks[pextIndex(occupancy, m.mask)];
+}
+#endif
+
+bool cpuHasBmi2() {
+#ifdef HAS_PEXT
+  return __builtin_cpu_supports("bmi2");
+#else
+  return false;
+#endif
+}
 
-    if (!fail) {
-      // Found one! Save it.
-      Magic& mag = bishop ? bishopMagics[sq] : rookMagics[sq];
-      mag.mask = mask;
-      mag.magic = magic;
-      mag.shift = 64 - blockBits;
-
-      // Point to the correct part of the global table
-      if (bishop)
-        mag.attacks = &bishopAttackTable[sq * 512];
-      else
-        mag.attacks = &rookAttackTable[sq * 4096];
-
-      // Fill the actual table
-      for (int i = 0; i < var; i++) {
-        int index = transform(blockers[i], magic, blockBits);
-        mag.attacks[index] = attacks[i];
-      }
-      return;
+// BMI2 and a PEXT that is actually fast: AMD before Zen 3 runs it in microcode,
+// far slower than the multiply
+bool cpuHasFastPext() {
+#ifdef HAS_PEXT
+  if (!cpuHasBmi2()) return false;
+  unsigned eax, ebx, ecx, edx;
+  if (!__get_cpuid(0, &eax, &ebx, &ecx, &edx)) return false;
+  bool amd = ebx == 0x68747541;  // "AuthenticAMD"
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return false;
+  unsigned family = ((eax >> 8) & 0xF) + ((eax >> 20) & 0xFF);
+  return !amd || family >= 0x19;
+#else
+  return false;
+#endif
+}
+
+// Both schemes index the same slices, in a different order: refill for the active one
+void fillTable() {
+  for (int bishop = 0; bishop <= 1; bishop++) {
+    for (int sq = 0; sq < 64; sq++) {
+      const Magic& m = bishop ? bishopMagics[sq] : rookMagics[sq];
+      // Every subset of the mask (carry-rippler)
+      Bitboard block = 0;
+      do {
+#ifdef HAS_PEXT
+        size_t index = activeBackend == SliderBackend::Pext ? pextIndex(block, m.mask)
+                                                             : (block * m.magic) >> m.shift;
+#else
+        size_t index = (block * m.magic) >> m.shift;
+#endif
+        m.attacks[index] = slidingAttacks(sq, block, bishop);
+        block = (block - m.mask) & m.mask;
+      } while (block);
     }
   }
 }
 
+}  // namespace
+
 void init_magic_bitboards() {
-  for (int i = 0; i < 64; i++) find_magic(i, 12, 0);  // Rooks
-  for (int i = 0; i < 64; i++) find_magic(i, 9, 1);   // Bishops
+  static bool initialized = false;
+  if (initialized) return;
+  initialized = true;
+
+#ifdef MADV_HUGEPAGE
+  // A hint only: whether the table really gets a huge page is up to the kernel's THP mode
+  madvise(attackTable, sizeof(attackTable), MADV_HUGEPAGE);
+#endif
+
+  setSliderBackend(SliderBackend::Auto);
+}
+
+bool setSliderBackend(SliderBackend backend) {
+  if (backend == SliderBackend::Auto) {
+    backend = cpuHasFastPext() ? SliderBackend::Pext : SliderBackend::Magic;
+  }
+  // Forcing PEXT only needs BMI2, slow or not
+  if (backend == SliderBackend::Pext && !cpuHasBmi2()) return false;
+
+  activeBackend = backend;
+  fillTable();
+  return true;
+}
+
+const char* sliderBackendName() {
+  return activeBackend == SliderBackend::Pext ? "PEXT" : "magic";
 }
 
 Bitboard get_rook_attacks(int square, Bitboard occupancy) {
-  Magic& m = rookMagics[square];
+#ifdef HAS_PEXT
+  if (activeBackend == SliderBackend::Pext) return pextRookAttacks(square, occupancy);
+#endif
+  const Magic& m = rookMagics[square];
   occupancy &= m.mask;
   occupancy *= m.magic;
   occupancy >>= m.shift;
@@ -187,9 +256,49 @@ Bitboard get_rook_attacks(int square, Bitboard occupancy) {
 }
 
 Bitboard get_bishop_attacks(int square, Bitboard occupancy) {
-  Magic& m = bishopMagics[square];
+#ifdef HAS_PEXT
+  if (activeBackend == SliderBackend::Pext) return pextBishopAttacks(square, occupancy);
+#endif
+  const Magic& m = bishopMagics[square];
   occupancy &= m.mask;
   occupancy *= m.magic;
   occupancy >>= m.shift;
   return m.attacks[occupancy];
 }
+
+uint64_t attackBenchmark(int milliseconds) {
+  // Random squares and blockers (about 1 in 4 squares occupied), so lookups land all
+  // over the table the way they do in a search
+  std::vector<std::pair<int, Bitboard>> queries(1 << 16);
+  uint64_t seed = 0x9E3779B97F4A7C15ULL;
+  auto next = [&seed] {
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return seed;
+  };
+  for (auto& [square, occupancy] : queries) {
+    square = (int)(next() & 63);
+    occupancy = next() & next();
+  }
+
+  uint64_t lookups = 0;
+  Bitboard checksum = 0;  // Keeps the lookups from being optimised away
+  auto start = std::chrono::steady_clock::now();
+  auto deadline = start + std::chrono::milliseconds(milliseconds);
+
+  while (std::chrono::steady_clock::now() < deadline) {
+    for (const auto& [square, occupancy] : queries) {
+      checksum += get_rook_attacks(square, occupancy) ^ get_bishop_attacks(square, occupancy);
+    }
+    lookups += 2 * queries.size();
+  }
+
+  long long elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+  std::cout << "info string attack " << sliderBackendName() << " lookups " << lookups << " time " << elapsed
+            << " lookups/s " << lookups * 1000 / std::max(1LL, elapsed) << " checksum "
+            << checksum << std::endl;
+  return lookups;
+}
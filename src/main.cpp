@@ -1,9 +1,20 @@
+#include <sstream>
+#include <string>
+
 #include "../include/UCIHandler.hpp"
 
-int main() {
+int main(int argc, char* argv[]) {
 
     UCIHandler uciHandler;
 
+    // "chess_engine bench [depth] [threads] [hashMB]": run the benchmark and exit
+    if (argc > 1 && std::string(argv[1]) == "bench") {
+        std::string command;
+        for (int i = 1; i < argc; i++) command += std::string(argv[i]) + " ";
+        std::istringstream script(command + "\nquit\n");
+        return uciHandler.loop(script);
+    }
+
     uciHandler.loop();
 
     return 0;
@@ -0,0 +1,171 @@
+#include "../include/material.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "../include/bitbase.hpp"
+#include "../include/position.hpp"
+
+namespace {
+
+// Phase weight per piece type (pawns and kings don't count)
+constexpr int PHASE_WEIGHT[6] = {0, 1, 1, 2, 4, 0};
+
+const int BISHOP_PAIR_BONUS = 30;
+// Won endgames score above anything the normal evaluation produces
+const int KNOWN_WIN = 10000;
+
+const uint64_t DARK_SQUARES = 0xAA55AA55AA55AA55ULL;
+const uint64_t FILE_A = 0x0101010101010101ULL;
+const uint64_t FILE_H = FILE_A << 7;
+
+int distance(int a, int b) { return std::max(std::abs(a % 8 - b % 8), std::abs(a / 8 - b / 8)); }
+
+// 0 in the center .. 120 in the corners
+int pushToEdge(int sq) {
+  int file = sq % 8, rank = sq / 8;
+  return 20 * (6 - std::min(file, 7 - file) - std::min(rank, 7 - rank));
+}
+
+int pushClose(int a, int b) { return 140 - 20 * distance(a, b); }
+
+int manhattan(int a, int b) { return std::abs(a % 8 - b % 8) + std::abs(a / 8 - b / 8); }
+
+int nonPawnMaterial(const Position& pos, Color side) {
+  int npm = 0;
+  for (int p = KNIGHT; p <= QUEEN; p++) {
+    npm += __builtin_popcountll(pos.pieces[side][p]) * pieceValues[p];
+  }
+  return npm;
+}
+
+// Lone king against enough material to mate: drive it to the edge and bring the king
+int evaluateKXK(const Position& pos, Color strong) {
+  Color weak = (strong == WHITE) ? BLACK : WHITE;
+  int strongKing = __builtin_ctzll(pos.pieces[strong][KING]);
+  int weakKing = __builtin_ctzll(pos.pieces[weak][KING]);
+
+  int score = nonPawnMaterial(pos, strong) +
+              __builtin_popcountll(pos.pieces[strong][PAWN]) * pieceValues[PAWN] +
+              pushToEdge(weakKing) + pushClose(strongKing, weakKing);
+
+  uint64_t bishops = pos.pieces[strong][BISHOP];
+  if (pos.pieces[strong][QUEEN] || pos.pieces[strong][ROOK] || pos.pieces[strong][PAWN] ||
+      (pos.pieces[strong][KNIGHT] && bishops) ||
+      ((bishops & DARK_SQUARES) && (bishops & ~DARK_SQUARES))) {
+    score += KNOWN_WIN;
+  }
+  return score;
+}
+
+// KPK: exact from the bitbase; a won position scores higher as the pawn advances
+int evaluateKPK(const Position& pos, Color strong) {
+  Color weak = (strong == WHITE) ? BLACK : WHITE;
+  int strongKing = __builtin_ctzll(pos.pieces[strong][KING]);
+  int weakKing = __builtin_ctzll(pos.pieces[weak][KING]);
+  int pawn = __builtin_ctzll(pos.pieces[strong][PAWN]);
+
+  if (!bitbase::probeKPK(strong, strongKing, pawn, weakKing, pos.mSideToMove)) return 0;
+
+  int relativeRank = (strong == WHITE) ? pawn / 8 : 7 - pawn / 8;
+  return KNOWN_WIN + pieceValues[PAWN] + 20 * relativeRank;
+}
+
+// KBNK: mate only works in a corner of the bishop's color
+int evaluateKBNK(const Position& pos, Color strong) {
+  Color weak = (strong == WHITE) ? BLACK : WHITE;
+  int strongKing = __builtin_ctzll(pos.pieces[strong][KING]);
+  int weakKing = __builtin_ctzll(pos.pieces[weak][KING]);
+
+  // a1 and h8 are dark
+  bool dark = pos.pieces[strong][BISHOP] & DARK_SQUARES;
+  int cornerDistance = dark ? std::min(manhattan(weakKing, 0), manhattan(weakKing, 63))
+                            : std::min(manhattan(weakKing, 7), manhattan(weakKing, 56));
+
+  return KNOWN_WIN + pieceValues[BISHOP] + pieceValues[KNIGHT] + pushClose(strongKing, weakKing) +
+         10 * (14 - cornerDistance);
+}
+
+// Bishop and rook pawns where the bishop does not control the promotion square: a draw
+// once the defending king reaches the corner
+int scaleKBPsK(const Position& pos, Color strong) {
+  Color weak = (strong == WHITE) ? BLACK : WHITE;
+  uint64_t pawns = pos.pieces[strong][PAWN];
+  uint64_t rookFile = (pawns & ~FILE_A) == 0 ? FILE_A : (pawns & ~FILE_H) == 0 ? FILE_H : 0;
+  if (!rookFile) return SCALE_NORMAL;
+
+  uint64_t lastRank = (strong == WHITE) ? 0xFF00000000000000ULL : 0xFFULL;
+  int queeningSq = __builtin_ctzll(rookFile & lastRank);
+  bool bishopDark = pos.pieces[strong][BISHOP] & DARK_SQUARES;
+  bool cornerDark = (DARK_SQUARES >> queeningSq) & 1;
+  if (bishopDark == cornerDark) return SCALE_NORMAL;
+
+  int weakKing = __builtin_ctzll(pos.pieces[weak][KING]);
+  return distance(weakKing, queeningSq) <= 1 ? SCALE_DRAW : SCALE_NORMAL;
+}
+
+}  // namespace
+
+MaterialTable::MaterialTable() : mEntries(new MaterialEntry[SIZE]) {}
+
+MaterialEntry* MaterialTable::probe(const Position& pos) {
+  uint64_t key = pos.mMaterialKey;
+  MaterialEntry* entry = &mEntries[key & (SIZE - 1)];
+  if (entry->key == key) return entry;
+
+  *entry = MaterialEntry();
+  entry->key = key;
+
+  int count[COLOR_NB][6];
+  for (int c = WHITE; c <= BLACK; c++) {
+    for (int p = PAWN; p <= KING; p++) count[c][p] = __builtin_popcountll(pos.pieces[c][p]);
+  }
+
+  int phase = 0;
+  for (int c = WHITE; c <= BLACK; c++) {
+    for (int p = KNIGHT; p <= QUEEN; p++) phase += count[c][p] * PHASE_WEIGHT[p];
+  }
+  entry->phase = (uint8_t)std::min(phase, PHASE_MIDGAME);
+
+  entry->imbalance = (int16_t)(((count[WHITE][BISHOP] >= 2) - (count[BLACK][BISHOP] >= 2)) *
+                               BISHOP_PAIR_BONUS);
+
+  for (int c = WHITE; c <= BLACK; c++) {
+    Color us = (Color)c, them = (c == WHITE) ? BLACK : WHITE;
+    int npmUs = nonPawnMaterial(pos, us), npmThem = nonPawnMaterial(pos, them);
+    bool loneKing = npmThem == 0 && count[them][PAWN] == 0;
+
+    // Specialized evaluation against a lone king
+    if (loneKing && !entry->evaluationFn) {
+      if (npmUs == 0 && count[us][PAWN] == 1) {
+        entry->evaluationFn = evaluateKPK;
+        entry->strongSide = us;
+      } else if (count[us][PAWN] == 0 && npmUs == pieceValues[BISHOP] + pieceValues[KNIGHT] &&
+          count[us][BISHOP] == 1) {
+        entry->evaluationFn = evaluateKBNK;
+        entry->strongSide = us;
+      } else if (npmUs >= pieceValues[ROOK] &&
+                 !(count[us][PAWN] == 0 && npmUs == 2 * pieceValues[KNIGHT])) {
+        entry->evaluationFn = evaluateKXK;
+        entry->strongSide = us;
+      }
+    }
+
+    // Without pawns, a minor piece more is not enough
+    if (count[us][PAWN] == 0) {
+      if (npmUs - npmThem <= pieceValues[BISHOP]) {
+        entry->factor[us] = npmUs < pieceValues[ROOK] ? SCALE_DRAW
+                            : npmThem <= pieceValues[BISHOP] ? 4
+                                                            : 14;
+      } else if (npmUs == 2 * pieceValues[KNIGHT] && count[us][KNIGHT] == 2 && loneKing) {
+        entry->factor[us] = SCALE_DRAW;
+      }
+    }
+
+    if (npmUs == pieceValues[BISHOP] && count[us][BISHOP] == 1 && count[us][PAWN] > 0) {
+      entry->scaleFn[us] = scaleKBPsK;
+    }
+  }
+
+  return entry;
+}
@@ -0,0 +1,241 @@
+#include "../include/mobility.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "../include/attack.hpp"
+#include "../include/magicBitboards.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace mobility {
+
+namespace {
+
+#if defined(__AVX2__)
+constexpr uint64_t NOT_A = 0xFEFEFEFEFEFEFEFEULL;
+constexpr uint64_t NOT_AB = 0xFCFCFCFCFCFCFCFCULL;
+constexpr uint64_t NOT_H = 0x7F7F7F7F7F7F7F7FULL;
+constexpr uint64_t NOT_GH = 0x3F3F3F3F3F3F3F3FULL;
+constexpr uint64_t ANY = ~0ULL;
+
+// A square offset and the squares it may land on without wrapping around the board
+struct Direction {
+  int shift;
+  uint64_t wrap;
+};
+
+constexpr Direction BISHOP_DIRS[4] = {{9, NOT_A}, {7, NOT_H}, {-7, NOT_A}, {-9, NOT_H}};
+constexpr Direction ROOK_DIRS[4] = {{8, ANY}, {1, NOT_A}, {-8, ANY}, {-1, NOT_H}};
+constexpr Direction KNIGHT_JUMPS[8] = {{17, NOT_A},  {15, NOT_H},   {10, NOT_AB}, {6, NOT_GH},
+                                       {-6, NOT_AB}, {-10, NOT_GH}, {-15, NOT_A}, {-17, NOT_H}};
+
+// Four directions side by side. Each lane shifts one way only: variable shifts by 64
+// or more give zero, so OR-ing a left and a right shift picks the lane's direction.
+struct Lanes {
+  __m256i left[3];  // Shift by s, 2s and 4s
+  __m256i right[3];
+  __m256i wrap;
+};
+
+Lanes makeLanes(const Direction* d) {
+  Lanes l;
+  for (int k = 0; k < 3; k++) {
+    long long left[4], right[4];
+    for (int i = 0; i < 4; i++) {
+      left[i] = d[i].shift > 0 ? (long long)d[i].shift << k : 64;
+      right[i] = d[i].shift < 0 ? (long long)-d[i].shift << k : 64;
+    }
+    l.left[k] = _mm256_setr_epi64x(left[0], left[1], left[2], left[3]);
+    l.right[k] = _mm256_setr_epi64x(right[0], right[1], right[2], right[3]);
+  }
+  l.wrap = _mm256_setr_epi64x((long long)d[0].wrap, (long long)d[1].wrap, (long long)d[2].wrap,
+                              (long long)d[3].wrap);
+  return l;
+}
+
+const Lanes BISHOP_LANES = makeLanes(BISHOP_DIRS);
+const Lanes ROOK_LANES = makeLanes(ROOK_DIRS);
+const Lanes KNIGHT_LANES[2] = {makeLanes(KNIGHT_JUMPS), makeLanes(KNIGHT_JUMPS + 4)};
+
+inline __m256i vshift(__m256i b, const Lanes& l, int k) {
+  return _mm256_or_si256(_mm256_sllv_epi64(b, l.left[k]), _mm256_srlv_epi64(b, l.right[k]));
+}
+
+// slide() for four directions at once
+inline __m256i vslide(uint64_t pieces, uint64_t empty, const Lanes& l) {
+  __m256i gen = _mm256_set1_epi64x((long long)pieces);
+  __m256i pro = _mm256_and_si256(_mm256_set1_epi64x((long long)empty), l.wrap);
+  gen = _mm256_or_si256(gen, _mm256_and_si256(pro, vshift(gen, l, 0)));
+  pro = _mm256_and_si256(pro, vshift(pro, l, 0));
+  gen = _mm256_or_si256(gen, _mm256_and_si256(pro, vshift(gen, l, 1)));
+  pro = _mm256_and_si256(pro, vshift(pro, l, 1));
+  gen = _mm256_or_si256(gen, _mm256_and_si256(pro, vshift(gen, l, 2)));
+  return _mm256_and_si256(vshift(gen, l, 0), l.wrap);
+}
+
+inline __m256i vjump(uint64_t pieces, uint64_t targets, const Lanes& l) {
+  __m256i to = vshift(_mm256_set1_epi64x((long long)pieces), l, 0);
+  return _mm256_and_si256(to, _mm256_and_si256(l.wrap, _mm256_set1_epi64x((long long)targets)));
+}
+
+// Bits set per 64-bit lane: nibble lookups, then a byte sum per lane
+inline __m256i vpopcount(__m256i b) {
+  const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1,
+                                         2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i nibble = _mm256_set1_epi8(0x0F);
+  __m256i lo = _mm256_shuffle_epi8(table, _mm256_and_si256(b, nibble));
+  __m256i hi = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(b, 4), nibble));
+  return _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256());
+}
+
+// Adds up the four lanes
+inline uint64_t vsum64(__m256i v) {
+  __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+  return (uint64_t)_mm_cvtsi128_si64(sum) + (uint64_t)_mm_extract_epi64(sum, 1);
+}
+#endif
+
+MobilityKernel activeKernel = MobilityKernel::PerPiece;
+
+}  // namespace
+
+bool setKernel(MobilityKernel kernel) {
+#if !defined(__AVX2__)
+  if (kernel == MobilityKernel::Setwise) return false;
+#endif
+  activeKernel = kernel;
+  return true;
+}
+
+const char* kernelName() {
+  return activeKernel == MobilityKernel::Setwise ? "set-wise" : "per-piece";
+}
+
+Counts evaluate(const Position& pos, Color side) {
+  return activeKernel == MobilityKernel::Setwise ? count(pos, side) : countPerPiece(pos, side);
+}
+
+Counts count(const Position& pos, Color side) {
+#if defined(__AVX2__)
+  uint64_t empty = ~pos.occupancies[2];
+  uint64_t targets = ~pos.occupancies[side];
+  uint64_t bishops = pos.pieces[side][BISHOP];
+  uint64_t knights = pos.pieces[side][KNIGHT];
+  uint64_t rooks = pos.pieces[side][ROOK];
+
+  // A lane counts at most 64 squares, so the three totals share one reduction 16 bits apart
+  __m256i bishop = vpopcount(vslide(bishops, empty, BISHOP_LANES));
+  __m256i rook = vpopcount(vslide(rooks, empty, ROOK_LANES));
+  __m256i knight = _mm256_add_epi64(vpopcount(vjump(knights, targets, KNIGHT_LANES[0])),
+                                    vpopcount(vjump(knights, targets, KNIGHT_LANES[1])));
+  uint64_t sum = vsum64(_mm256_or_si256(
+      bishop, _mm256_or_si256(_mm256_slli_epi64(knight, 16), _mm256_slli_epi64(rook, 32))));
+  Counts c;
+  c.bishop = (int)(sum & 0xFFFF);
+  c.knight = (int)((sum >> 16) & 0xFFFF);
+  c.rook = (int)(sum >> 32);
+  return c;
+#else
+  // Set-wise fills one direction at a time cost more than a lookup per piece
+  return countPerPiece(pos, side);
+#endif
+}
+
+Counts countPerPiece(const Position& pos, Color side) {
+  uint64_t occupancy = pos.occupancies[2];
+  Counts c;
+
+  for (uint64_t b = pos.pieces[side][BISHOP]; b; b &= b - 1) {
+    c.bishop += __builtin_popcountll(get_bishop_attacks(__builtin_ctzll(b), occupancy));
+  }
+  for (uint64_t b = pos.pieces[side][KNIGHT]; b; b &= b - 1) {
+    c.knight += __builtin_popcountll(attack::knightAttacks[__builtin_ctzll(b)] &
+                                     ~pos.occupancies[side]);
+  }
+  for (uint64_t b = pos.pieces[side][ROOK]; b; b &= b - 1) {
+    c.rook += __builtin_popcountll(get_rook_attacks(__builtin_ctzll(b), occupancy));
+  }
+  return c;
+}
+
+const char* simdName() {
+#if defined(__AVX2__)
+  return "AVX2";
+#else
+  return "scalar";
+#endif
+}
+
+uint64_t benchmark(int milliseconds) {
+  static const char* fens[] = {
+      "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+      "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+      "2r2rk1/1bqnbpp1/1p1ppn1p/pP6/N1P1P3/P2B1N1P/1B2QPP1/R2R2K1 b - - 0 1",
+      "r1b2rk1/2q1b1pp/p2ppn2/1p6/3QP3/1BN1B3/PPP3PP/R4RK1 w - - 0 1",
+      "3rr1k1/pp3pp1/1qn2np1/8/3p4/PP1R1P2/2P1NQPP/R1B3K1 b - - 0 1",
+      "1k1r3r/pp2qpp1/3b1n1p/3pNQ2/2pP1P2/2N1P3/PP4PP/1K1RR3 b - - 0 1",
+      "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+      "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"};
+
+  auto same = [](const Position& pos) {
+    for (Color side : {WHITE, BLACK}) {
+      Counts a = count(pos, side), b = countPerPiece(pos, side);
+      if (a.bishop != b.bishop || a.knight != b.knight || a.rook != b.rook) return false;
+    }
+    return true;
+  };
+
+  // Check the positions and everything one move away before timing anything
+  std::vector<Position> positions(std::size(fens));
+  uint64_t checked = 0, mismatches = 0;
+  for (size_t i = 0; i < std::size(fens); i++) {
+    Position& pos = positions[i];
+    pos.setStartingPosition(fens[i]);
+    MoveList moves;
+    pos.generate<ALL>(moves);
+    mismatches += !same(pos);
+    for (int j = 0; j < moves.count; j++) {
+      pos.doMove(moves.moves[j]);
+      mismatches += !same(pos);
+      pos.undoMove(moves.moves[j]);
+    }
+    checked += moves.count + 1;
+  }
+
+  auto run = [&](const char* name, auto counter) {
+    uint64_t evals = 0;
+    int64_t checksum = 0;  // Keeps the calls from being optimised away
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::milliseconds(milliseconds);
+
+    while (std::chrono::steady_clock::now() < deadline) {
+      for (int rep = 0; rep < 1000; rep++) {
+        for (const Position& pos : positions) {
+          Counts w = counter(pos, WHITE), b = counter(pos, BLACK);
+          checksum += w.bishop - b.bishop + 2 * (w.knight - b.knight) + 3 * (w.rook - b.rook);
+        }
+        evals += positions.size();
+      }
+    }
+
+    long long elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+    std::cout << "info string mobility " << name << " evals " << evals << " time " << elapsed
+              << " evals/s " << evals * 1000 / std::max(1LL, elapsed) << " checksum "
+              << checksum << std::endl;
+  };
+
+  run(simdName(), count);
+  run("per-piece", countPerPiece);
+  std::cout << "info string mobility checked " << checked << " positions, " << mismatches
+            << " mismatches" << std::endl;
+  return mismatches;
+}
+
+}  // namespace mobility
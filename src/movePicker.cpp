@@ -0,0 +1,170 @@
+#include "../include/movePicker.hpp"
+
+// Quiet promotions go ahead of every history score
+const int PROMOTION_SCORE = 900000;
+
+static bool sameMove(const Move& a, const Move& b) {
+  return a.from == b.from && a.to == b.to && a.promotion == b.promotion;
+}
+
+MovePicker::MovePicker(Position& pos, Move ttMove, const Move (&killers)[2],
+                       const int (&history)[2][64][64])
+    : mPos(pos), mHistory(history[pos.mSideToMove]), mTTMove(ttMove), mStage(TT_MOVE) {
+  mKillers[0] = killers[0];
+  mKillers[1] = killers[1];
+
+  if (!mPos.isPseudoLegal(mTTMove) || !mPos.isLegal(mTTMove)) {
+    mTTMove = Move::null();
+    mStage = INIT_CAPTURES;
+  }
+}
+
+MovePicker::MovePicker(Position& pos)
+    : mPos(pos), mHistory(nullptr), mTTMove(Move::null()), mStage(QS_INIT_CAPTURES) {
+  mKillers[0] = Move::null();
+  mKillers[1] = Move::null();
+}
+
+bool MovePicker::isCaptureGood(const Move& m) const {
+  int attacker = mPos.board[m.from];
+  int victim = mPos.board[m.to];
+  if (victim == NOPIECE) return true;  // En passant: pawn for pawn
+  // Legal king captures and trading up never lose material; skip the SEE
+  if (attacker == KING || pieceValues[victim] >= pieceValues[attacker]) return true;
+  return mPos.see(m) >= 0;
+}
+
+bool MovePicker::isSpecial(const Move& m) const {
+  return (mTTMove.from != mTTMove.to && sameMove(m, mTTMove)) ||
+         (mKillers[0].from != mKillers[0].to && sameMove(m, mKillers[0])) ||
+         (mKillers[1].from != mKillers[1].to && sameMove(m, mKillers[1]));
+}
+
+void MovePicker::scoreCaptures() {
+  for (int i = 0; i < mMoves.count; i++) {
+    Move& m = mMoves.moves[i];
+    int victim = mPos.board[m.to];
+    int attacker = mPos.board[m.from];
+
+    m.score = mvv_lva[victim == NOPIECE ? PAWN : victim][attacker];
+    if (m.promotion != NOPIECE) m.score += pieceValues[m.promotion];
+  }
+}
+
+void MovePicker::scoreQuiets() {
+  for (int i = 0; i < mMoves.count; i++) {
+    Move& m = mMoves.moves[i];
+    if (m.promotion != NOPIECE) {
+      m.score = PROMOTION_SCORE + pieceValues[m.promotion];
+    } else {
+      m.score = mHistory[m.from][m.to];
+    }
+  }
+}
+
+Move MovePicker::pickBest() {
+  int bestIndex = mCurrent;
+  for (int i = mCurrent + 1; i < mMoves.count; i++) {
+    if (mMoves.moves[i].score > mMoves.moves[bestIndex].score) bestIndex = i;
+  }
+  Move best = mMoves.moves[bestIndex];
+  mMoves.moves[bestIndex] = mMoves.moves[mCurrent];
+  mMoves.moves[mCurrent] = best;
+  mCurrent++;
+  return best;
+}
+
+bool MovePicker::next(Move& m) {
+  switch (mStage) {
+    case TT_MOVE:
+      mStage = INIT_CAPTURES;
+      m = mTTMove;
+      return true;
+
+    case INIT_CAPTURES:
+      mMoves.clear();
+      mCurrent = 0;
+      mPos.generate<::CAPTURES>(mMoves);
+      scoreCaptures();
+      mStage = GOOD_CAPTURES;
+      [[fallthrough]];
+
+    case GOOD_CAPTURES:
+      while (mCurrent < mMoves.count) {
+        Move candidate = pickBest();
+        if (sameMove(candidate, mTTMove)) continue;
+        if (!isCaptureGood(candidate)) {
+          mBadCaptures.add(candidate, candidate.score);
+          continue;
+        }
+        m = candidate;
+        return true;
+      }
+      mStage = KILLER_1;
+      [[fallthrough]];
+
+    case KILLER_1:
+    case KILLER_2:
+      while (mStage == KILLER_1 || mStage == KILLER_2) {
+        const Move& killer = mKillers[mStage - KILLER_1];
+        mStage++;
+        // Killers were quiet where they were found; here they must still be quiet and
+        // playable (en passant is a capture and was handed out above)
+        bool quiet = mPos.board[killer.to] == NOPIECE &&
+                     !(mPos.board[killer.from] == PAWN &&
+                       (1ULL << killer.to) == mPos.mEnPassentSquare);
+        if (killer.from != killer.to && !sameMove(killer, mTTMove) && quiet &&
+            mPos.isPseudoLegal(killer) && mPos.isLegal(killer)) {
+          m = killer;
+          return true;
+        }
+      }
+      [[fallthrough]];
+
+    case INIT_QUIETS:
+      mMoves.clear();
+      mCurrent = 0;
+      mPos.generate<::QUIETS>(mMoves);
+      scoreQuiets();
+      mStage = QUIETS;
+      [[fallthrough]];
+
+    case QUIETS:
+      while (mCurrent < mMoves.count) {
+        Move candidate = pickBest();
+        if (isSpecial(candidate)) continue;
+        m = candidate;
+        return true;
+      }
+      mStage = BAD_CAPTURES;
+      [[fallthrough]];
+
+    case BAD_CAPTURES:
+      if (mBadCurrent < mBadCaptures.count) {
+        m = mBadCaptures.moves[mBadCurrent++];
+        return true;
+      }
+      mStage = DONE;
+      return false;
+
+    case QS_INIT_CAPTURES:
+      mMoves.clear();
+      mCurrent = 0;
+      mPos.generate<::CAPTURES>(mMoves);
+      scoreCaptures();
+      mStage = QS_CAPTURES;
+      [[fallthrough]];
+
+    case QS_CAPTURES:
+      while (mCurrent < mMoves.count) {
+        m = pickBest();
+        if (!isCaptureGood(m)) continue;
+        return true;
+      }
+      mStage = DONE;
+      return false;
+
+    default:
+      return false;
+  }
+}
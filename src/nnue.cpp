@@ -0,0 +1,229 @@
+#include "../include/nnue.hpp"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+
+namespace nnue {
+
+namespace {
+
+struct alignas(64) Network {
+  int16_t featureWeights[INPUTS][HIDDEN];
+  int16_t featureBias[HIDDEN];
+  int16_t outputWeights[2 * HIDDEN];
+  int16_t outputBias;
+};
+
+constexpr size_t NETWORK_BYTES = (INPUTS * HIDDEN + HIDDEN + 2 * HIDDEN + 1) * sizeof(int16_t);
+
+Network network;
+bool loaded = false;
+
+inline int featureIndex(Color perspective, const Feature& f) {
+  // Each side sees itself as white on its own first rank
+  int square = (perspective == WHITE) ? f.square : (f.square ^ 56);
+  int side = (f.color == perspective) ? 0 : 1;
+  return side * 384 + f.piece * 64 + square;
+}
+
+#if defined(__AVX2__)
+using Vec = __m256i;
+constexpr int LANES = 16;
+inline Vec vload(const int16_t* p) { return _mm256_load_si256((const Vec*)p); }
+inline void vstore(int16_t* p, Vec v) { _mm256_store_si256((Vec*)p, v); }
+inline Vec vadd16(Vec a, Vec b) { return _mm256_add_epi16(a, b); }
+inline Vec vsub16(Vec a, Vec b) { return _mm256_sub_epi16(a, b); }
+inline Vec vclamp16(Vec v) {
+  return _mm256_min_epi16(_mm256_max_epi16(v, _mm256_setzero_si256()), _mm256_set1_epi16(QA));
+}
+inline Vec vmullo16(Vec a, Vec b) { return _mm256_mullo_epi16(a, b); }
+inline Vec vmadd16(Vec a, Vec b) { return _mm256_madd_epi16(a, b); }
+inline Vec vadd32(Vec a, Vec b) { return _mm256_add_epi32(a, b); }
+inline Vec vzero() { return _mm256_setzero_si256(); }
+inline int vsum32(Vec v) {
+  __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+  return _mm_cvtsi128_si32(sum);
+}
+#elif defined(__SSE4_1__)
+using Vec = __m128i;
+constexpr int LANES = 8;
+inline Vec vload(const int16_t* p) { return _mm_load_si128((const Vec*)p); }
+inline void vstore(int16_t* p, Vec v) { _mm_store_si128((Vec*)p, v); }
+inline Vec vadd16(Vec a, Vec b) { return _mm_add_epi16(a, b); }
+inline Vec vsub16(Vec a, Vec b) { return _mm_sub_epi16(a, b); }
+inline Vec vclamp16(Vec v) {
+  return _mm_min_epi16(_mm_max_epi16(v, _mm_setzero_si128()), _mm_set1_epi16(QA));
+}
+inline Vec vmullo16(Vec a, Vec b) { return _mm_mullo_epi16(a, b); }
+inline Vec vmadd16(Vec a, Vec b) { return _mm_madd_epi16(a, b); }
+inline Vec vadd32(Vec a, Vec b) { return _mm_add_epi32(a, b); }
+inline Vec vzero() { return _mm_setzero_si128(); }
+inline int vsum32(Vec v) {
+  v = _mm_add_epi32(v, _mm_shuffle_epi32(v, 0x4E));
+  v = _mm_add_epi32(v, _mm_shuffle_epi32(v, 0xB1));
+  return _mm_cvtsi128_si32(v);
+}
+#endif
+
+// sum(clamp(x, 0, QA)^2 * w) over one perspective's half of the hidden layer
+int screluDot(const int16_t* values, const int16_t* weights) {
+#if defined(__AVX2__) || defined(__SSE4_1__)
+  // clamp(x) * w fits in 16 bits since load() refuses |w| > MAX_OUTPUT_WEIGHT; madd
+  // then widens to 32 bits
+  Vec sum = vzero();
+  for (int i = 0; i < HIDDEN; i += LANES) {
+    Vec v = vclamp16(vload(values + i));
+    sum = vadd32(sum, vmadd16(vmullo16(v, vload(weights + i)), v));
+  }
+  return vsum32(sum);
+#else
+  int sum = 0;
+  for (int i = 0; i < HIDDEN; i++) {
+    int v = values[i] < 0 ? 0 : (values[i] > QA ? QA : values[i]);
+    sum += v * v * weights[i];
+  }
+  return sum;
+#endif
+}
+
+void updatePerspective(int16_t* values, const int* added, int addedCount, const int* removed,
+                       int removedCount) {
+#if defined(__AVX2__) || defined(__SSE4_1__)
+  for (int i = 0; i < HIDDEN; i += LANES) {
+    Vec v = vload(values + i);
+    for (int a = 0; a < addedCount; a++) {
+      v = vadd16(v, vload(&network.featureWeights[added[a]][i]));
+    }
+    for (int r = 0; r < removedCount; r++) {
+      v = vsub16(v, vload(&network.featureWeights[removed[r]][i]));
+    }
+    vstore(values + i, v);
+  }
+#else
+  for (int a = 0; a < addedCount; a++) {
+    for (int i = 0; i < HIDDEN; i++) values[i] += network.featureWeights[added[a]][i];
+  }
+  for (int r = 0; r < removedCount; r++) {
+    for (int i = 0; i < HIDDEN; i++) values[i] -= network.featureWeights[removed[r]][i];
+  }
+#endif
+}
+
+}  // namespace
+
+bool load(const std::string& path) {
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file) {
+    std::cout << "info string NNUE: cannot open " << path << std::endl;
+    return false;
+  }
+
+  size_t size = (size_t)file.tellg();
+  // The trainer pads the file to a multiple of 64 bytes
+  if (size < NETWORK_BYTES || size >= NETWORK_BYTES + 64) {
+    std::cout << "info string NNUE: " << path << " has " << size << " bytes, expected "
+              << NETWORK_BYTES << " (768 -> " << HIDDEN << ")x2 -> 1" << std::endl;
+    return false;
+  }
+
+  std::vector<int16_t> raw(NETWORK_BYTES / sizeof(int16_t));
+  file.seekg(0);
+  if (!file.read((char*)raw.data(), NETWORK_BYTES)) {
+    std::cout << "info string NNUE: read error on " << path << std::endl;
+    return false;
+  }
+
+  // Checked before anything is copied, so a refused net leaves the current one in place
+  const int16_t* outputWeights = raw.data() + INPUTS * HIDDEN + HIDDEN;
+  for (int i = 0; i < 2 * HIDDEN; i++) {
+    if (std::abs(outputWeights[i]) > MAX_OUTPUT_WEIGHT) {
+      std::cout << "info string NNUE: " << path << " has output weight " << outputWeights[i]
+                << ", beyond +-" << MAX_OUTPUT_WEIGHT << " (clip the weights when training)"
+                << std::endl;
+      return false;
+    }
+  }
+
+  const int16_t* p = raw.data();
+  for (int f = 0; f < INPUTS; f++) {
+    for (int i = 0; i < HIDDEN; i++) network.featureWeights[f][i] = *p++;
+  }
+  for (int i = 0; i < HIDDEN; i++) network.featureBias[i] = *p++;
+  for (int i = 0; i < 2 * HIDDEN; i++) network.outputWeights[i] = *p++;
+  network.outputBias = *p;
+
+  loaded = true;
+  std::cout << "info string NNUE: loaded " << path << " (" << simdName() << ")" << std::endl;
+  return true;
+}
+
+void unload() { loaded = false; }
+
+bool isLoaded() { return loaded; }
+
+const char* simdName() {
+#if defined(__AVX2__)
+  return "AVX2";
+#elif defined(__SSE4_1__)
+  return "SSE4.1";
+#else
+  return "scalar";
+#endif
+}
+
+void refresh(Accumulator& acc, const uint64_t (&pieces)[COLOR_NB][6]) {
+  int features[COLOR_NB][32];
+  int count = 0;
+
+  for (int c = WHITE; c <= BLACK; c++) {
+    for (int p = PAWN; p <= KING; p++) {
+      uint64_t bb = pieces[c][p];
+      while (bb) {
+        Feature f{c, p, __builtin_ctzll(bb)};
+        features[WHITE][count] = featureIndex(WHITE, f);
+        features[BLACK][count] = featureIndex(BLACK, f);
+        count++;
+        bb &= (bb - 1);
+      }
+    }
+  }
+
+  for (int perspective = WHITE; perspective <= BLACK; perspective++) {
+    for (int i = 0; i < HIDDEN; i++) acc.values[perspective][i] = network.featureBias[i];
+    updatePerspective(acc.values[perspective], features[perspective], count, nullptr, 0);
+  }
+}
+
+void update(Accumulator& acc, const Feature* added, int addedCount, const Feature* removed,
+            int removedCount) {
+  for (int perspective = WHITE; perspective <= BLACK; perspective++) {
+    int add[2] = {}, remove[2] = {};
+    for (int i = 0; i < addedCount; i++) add[i] = featureIndex((Color)perspective, added[i]);
+    for (int i = 0; i < removedCount; i++) {
+      remove[i] = featureIndex((Color)perspective, removed[i]);
+    }
+    updatePerspective(acc.values[perspective], add, addedCount, remove, removedCount);
+  }
+}
+
+int evaluate(const Accumulator& acc, Color sideToMove) {
+  Color other = (sideToMove == WHITE) ? BLACK : WHITE;
+
+  int sum = screluDot(acc.values[sideToMove], network.outputWeights) +
+            screluDot(acc.values[other], network.outputWeights + HIDDEN);
+
+  // sum is in QA * QA * QB units: take one QA off before adding the bias (QA * QB)
+  return (sum / QA + network.outputBias) * SCALE / (QA * QB);
+}
+
+}  // namespace nnue
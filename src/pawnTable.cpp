@@ -0,0 +1,11 @@
+#include "../include/pawnTable.hpp"
+
+PawnTable::PawnTable() : mEntries(new PawnEntry[SIZE]) {}
+
+PawnEntry* PawnTable::probe(uint64_t key, bool& found) {
+  PawnEntry* entry = &mEntries[key & (SIZE - 1)];
+  probes++;
+  found = entry->key == key;
+  if (found) hits++;
+  return entry;
+}
@@ -0,0 +1,191 @@
+#include "../include/perft.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "../include/position.hpp"
+#include "../include/utils.hpp"
+
+namespace perft {
+
+namespace {
+
+// Keeps counts of the same position at different depths apart
+inline uint64_t depthKey(uint64_t key, int depth) {
+  return key ^ ((uint64_t)depth * 0x9E3779B97F4A7C15ULL);
+}
+
+// Counts each root move's subtree; the root moves are handed out to 'threads' workers
+uint64_t split(Position& pos, int depth, int threads, PerftHash* hash,
+               std::vector<std::pair<Move, uint64_t>>& results) {
+  MoveList moves;
+  pos.getMoves(moves);
+  results.clear();
+  for (int i = 0; i < moves.count; i++) results.push_back({moves.moves[i], 0});
+  if (depth <= 1) {
+    for (auto& result : results) result.second = 1;
+    return moves.count;
+  }
+
+  std::atomic<size_t> next{0};
+  auto worker = [&] {
+    // Position carries its whole undo history: keep the copies off the stack
+    auto copy = std::make_unique<Position>(pos);
+    for (size_t i; (i = next++) < results.size();) {
+      copy->doMove(results[i].first);
+      results[i].second = count(*copy, depth - 1, hash);
+      copy->undoMove(results[i].first);
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for (int t = 1; t < std::min<int>(threads, moves.count); t++) pool.emplace_back(worker);
+  worker();
+  for (std::thread& thread : pool) thread.join();
+
+  uint64_t total = 0;
+  for (const auto& result : results) total += result.second;
+  return total;
+}
+
+long long elapsedMs(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+}  // namespace
+
+PerftHash::PerftHash(int sizeInMB) {
+  size_t entries = 1;
+  while (entries * 2 * sizeof(Entry) <= (size_t)sizeInMB * 1024 * 1024) entries *= 2;
+  mEntries.reset(new Entry[entries]);
+  mMask = entries - 1;
+}
+
+bool PerftHash::probe(uint64_t key, int depth, uint64_t& count) const {
+  key = depthKey(key, depth);
+  const Entry& entry = mEntries[key & mMask];
+  count = entry.count.load(std::memory_order_relaxed);
+  return (entry.keyXorCount.load(std::memory_order_relaxed) ^ count) == key;
+}
+
+void PerftHash::store(uint64_t key, int depth, uint64_t count) {
+  key = depthKey(key, depth);
+  Entry& entry = mEntries[key & mMask];
+  entry.keyXorCount.store(key ^ count, std::memory_order_relaxed);
+  entry.count.store(count, std::memory_order_relaxed);
+}
+
+uint64_t count(Position& pos, int depth, PerftHash* hash) {
+  if (depth == 0) return 1;
+
+  MoveList moves;
+  pos.getMoves(moves);
+  // Bulk counting: the generator is legal, so the last ply needs no doMove
+  if (depth == 1) return moves.count;
+
+  uint64_t nodes = 0;
+  if (hash && hash->probe(pos.getHash(), depth, nodes)) return nodes;
+  nodes = 0;
+
+  for (int i = 0; i < moves.count; i++) {
+    pos.doMove(moves.moves[i]);
+    nodes += count(pos, depth - 1, hash);
+    pos.undoMove(moves.moves[i]);
+  }
+
+  if (hash) hash->store(pos.getHash(), depth, nodes);
+  return nodes;
+}
+
+uint64_t divide(Position& pos, int depth, int threads, int hashMB, bool print) {
+  if (depth < 1) depth = 1;
+  std::unique_ptr<PerftHash> hash;
+  if (hashMB > 0) hash = std::make_unique<PerftHash>(hashMB);
+
+  std::vector<std::pair<Move, uint64_t>> results;
+  auto start = std::chrono::steady_clock::now();
+  uint64_t nodes = split(pos, depth, threads, hash.get(), results);
+  long long elapsed = elapsedMs(start);
+
+  if (print) {
+    for (const auto& [move, subtree] : results) {
+      std::cout << util::moveToString(move) << ": " << subtree << std::endl;
+    }
+    std::cout << std::endl;
+  }
+  std::cout << "info string perft depth " << depth << " nodes " << nodes << " time " << elapsed
+            << " nps " << nodes * 1000 / std::max(1LL, elapsed) << std::endl;
+  return nodes;
+}
+
+bool runSuite(int threads, int hashMB) {
+  struct Case {
+    const char* fen;
+    int depth;
+    uint64_t nodes;
+  };
+  static const Case cases[] = {
+      // Start position, Kiwipete and the other standard perft positions
+      {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 6, 119060324},
+      {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 5, 193690690},
+      {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 7, 178633661},
+      {"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 5, 15833292},
+      {"r2q1rk1/pP1p2pp/Q4n2/bbp1p3/Np6/1B3NBn/pPPP1PPP/R3K2R b KQ - 0 1", 5, 15833292},
+      {"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 5, 89941194},
+      {"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 5, 164075551},
+      // En passant: pinned, discovered and checking captures
+      {"3k4/3p4/8/K1P4r/8/8/8/8 b - - 0 1", 6, 1134888},
+      {"8/8/4k3/8/2p5/8/B2P2K1/8 w - - 0 1", 6, 1015133},
+      {"8/8/1k6/2b5/2pP4/8/5K2/8 b - d3 0 1", 6, 1440467},
+      // Castling
+      {"5k2/8/8/8/8/8/8/4K2R w K - 0 1", 6, 661072},
+      {"3k4/8/8/8/8/8/8/R3K3 w Q - 0 1", 6, 803711},
+      {"r3k2r/1b4bq/8/8/8/8/7B/R3K2R w KQkq - 0 1", 4, 1274206},
+      {"r3k2r/8/3Q4/8/8/5q2/8/R3K2R b KQkq - 0 1", 4, 1720476},
+      // Promotions, checks and stalemates
+      {"2K2r2/4P3/8/8/8/8/8/3k4 w - - 0 1", 6, 3821001},
+      {"8/8/1P2K3/8/2n5/1q6/8/5k2 b - - 0 1", 5, 1004658},
+      {"4k3/1P6/8/8/8/8/K7/8 w - - 0 1", 6, 217342},
+      {"8/P1k5/K7/8/8/8/8/8 w - - 0 1", 6, 92683},
+      {"K1k5/8/P7/8/8/8/8/8 w - - 0 1", 6, 2217},
+      {"8/k1P5/8/1K6/8/8/8/8 w - - 0 1", 7, 567584},
+      {"8/8/2k5/5q2/5n2/8/5K2/8 b - - 0 1", 4, 23527}};
+
+  auto pos = std::make_unique<Position>();
+  std::vector<std::pair<Move, uint64_t>> results;
+  uint64_t totalNodes = 0;
+  long long totalTime = 0;
+  int failed = 0;
+
+  for (const Case& c : cases) {
+    pos->setStartingPosition(c.fen);
+    std::unique_ptr<PerftHash> hash;
+    if (hashMB > 0) hash = std::make_unique<PerftHash>(hashMB);
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t nodes = split(*pos, c.depth, threads, hash.get(), results);
+    long long elapsed = elapsedMs(start);
+    totalNodes += nodes;
+    totalTime += elapsed;
+
+    bool ok = nodes == c.nodes;
+    if (!ok) failed++;
+    std::cout << "info string perft " << (ok ? "ok  " : "FAIL") << " depth " << c.depth
+              << " nodes " << nodes;
+    if (!ok) std::cout << " expected " << c.nodes;
+    std::cout << " time " << elapsed << " fen " << c.fen << std::endl;
+  }
+
+  std::cout << "info string perft suite " << (failed ? "FAILED" : "passed") << " ("
+            << std::size(cases) - failed << "/" << std::size(cases) << ") nodes " << totalNodes
+            << " time " << totalTime << " nps " << totalNodes * 1000 / std::max(1LL, totalTime)
+            << std::endl;
+  return failed == 0;
+}
+
+}  // namespace perft
@@ -1,9 +1,13 @@
 #include "../include/position.hpp"
 
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <cstdint>
 #include <iostream>
-#include <random>
+#include <iterator>
 #include <sstream>
+#include <vector>
 
 #include "../include/attack.hpp"
 #include "../include/magicBitboards.hpp"
@@ -12,48 +16,62 @@
 
 const uint64_t NOT_A_FILE = 0xFEFEFEFEFEFEFEFEULL;
 const uint64_t NOT_H_FILE = 0x7F7F7F7F7F7F7F7FULL;
-
-int PST_CACHE[2][6][64];
-
-void initPST() {
+const uint64_t RANK_2 = 0x000000000000FF00ULL;
+const uint64_t RANK_3 = 0x0000000000FF0000ULL;
+const uint64_t RANK_6 = 0x0000FF0000000000ULL;
+const uint64_t RANK_7 = 0x00FF000000000000ULL;
+
+// Piece value and square bonus in one lookup, negated for Black
+constexpr auto PST_CACHE = [] {
+  std::array<std::array<std::array<int, 64>, 6>, 2> table{};
   for (int p = 0; p < 6; p++) {
     for (int s = 0; s < 64; s++) {
-      // White: Direct copy
-      PST_CACHE[WHITE][p][s] = pieceValues[p] + PST[p][s];
-
-      // Black: Mirror and Negate
-      // Note: We bake the piece value into the table too!
-      // This saves the "val + PST..." addition at runtime.
-      PST_CACHE[BLACK][p][s] = -(pieceValues[p] + PST[p][s ^ 56]);
+      table[WHITE][p][s] = pieceValues[p] + PST[p][s];
+      table[BLACK][p][s] = -(pieceValues[p] + PST[p][s ^ 56]);
     }
   }
-}
+  return table;
+}();
 
 namespace Zobrist {
-uint64_t pieceKeys[2][6][64];  // [Color][Piece][Square]
-uint64_t enPassantKeys[64];    // [Square]
-uint64_t castleKeys[16];       // [CastleRights Mask]
-uint64_t sideKey;              // XORed if Black to move
-bool initialized = false;
 
-void init() {
-  if (initialized) return;
-  std::mt19937_64 gen(123456789);
-  std::uniform_int_distribution<uint64_t> dist;
-
-  for (int c = 0; c < 2; c++) {
-    for (int p = 0; p < 6; p++) {
-      for (int s = 0; s < 64; s++) {
-        pieceKeys[c][p][s] = dist(gen);
-      }
+struct Keys {
+  uint64_t piece[2][6][64];  // [Color][Piece][Square]
+  uint64_t enPassant[64];    // [Square]
+  uint64_t castle[16];       // [CastleRights Mask]
+  uint64_t side;             // XORed if Black to move
+  uint64_t noPawns;          // Pawn key with no pawns; keeps real keys away from 0
+};
+
+// xorshift64* from a fixed seed, run at compile time
+constexpr Keys makeKeys() {
+  uint64_t state = 1070372;
+  auto next = [&state] {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 2685821657736338717ULL;
+  };
+
+  Keys keys{};
+  for (auto& color : keys.piece) {
+    for (auto& piece : color) {
+      for (uint64_t& key : piece) key = next();
     }
   }
-
-  for (int i = 0; i < 64; i++) enPassantKeys[i] = dist(gen);
-  for (int i = 0; i < 16; i++) castleKeys[i] = dist(gen);
-  sideKey = dist(gen);
-  initialized = true;
+  for (uint64_t& key : keys.enPassant) key = next();
+  for (uint64_t& key : keys.castle) key = next();
+  keys.side = next();
+  keys.noPawns = next();
+  return keys;
 }
+
+constexpr Keys KEYS = makeKeys();
+constexpr const auto& pieceKeys = KEYS.piece;
+constexpr const auto& enPassantKeys = KEYS.enPassant;
+constexpr const auto& castleKeys = KEYS.castle;
+constexpr uint64_t sideKey = KEYS.side;
+constexpr uint64_t noPawnsKey = KEYS.noPawns;
 }  // namespace Zobrist
 
 uint64_t Position::predictChildHash(Move m) {
@@ -133,12 +151,6 @@ int Position::getPieceValue(int piece, int square, Color color) {
   return PST_CACHE[color][piece][square];
 }
 
-bool Position::isCheck() {
-  int kingSq = __builtin_ctzll(pieces[mSideToMove][KING]);
-  Color enemy = (mSideToMove == WHITE) ? BLACK : WHITE;
-  return isSquareAttacked(kingSq, enemy);
-}
-
 int Position::setStartingPosition(std::string startingPosition) {
   // Clear existing state first
   posEval.positionScore = 0;
@@ -162,6 +174,8 @@ int Position::setStartingPosition(std::string startingPosition) {
   occupancies[2] = 0ULL;
 
   mHash = 0ULL;
+  mPawnKey = Zobrist::noPawnsKey;
+  mMaterialKey = 0ULL;
 
   int rank = 7;
   int file = 0;
@@ -244,11 +258,19 @@ int Position::setStartingPosition(std::string startingPosition) {
 
   // 1. Pieces
   for (int p = 0; p < 6; p++) {
+    for (int n = 0; n < __builtin_popcountll(pieces[WHITE][p]); n++) {
+      mMaterialKey ^= Zobrist::pieceKeys[WHITE][p][n];
+    }
+    for (int n = 0; n < __builtin_popcountll(pieces[BLACK][p]); n++) {
+      mMaterialKey ^= Zobrist::pieceKeys[BLACK][p][n];
+    }
+
     uint64_t w = pieces[WHITE][p];
     while (w) {
       int sq = __builtin_ctzll(w);
       posEval.positionScore += getPieceValue(p, sq, WHITE);
       mHash ^= Zobrist::pieceKeys[WHITE][p][sq];
+      if (p == PAWN) mPawnKey ^= Zobrist::pieceKeys[WHITE][p][sq];
       w &= (w - 1);
     }
     uint64_t b = pieces[BLACK][p];
@@ -256,6 +278,7 @@ int Position::setStartingPosition(std::string startingPosition) {
       int sq = __builtin_ctzll(b);
       posEval.positionScore += getPieceValue(p, sq, BLACK);
       mHash ^= Zobrist::pieceKeys[BLACK][p][sq];
+      if (p == PAWN) mPawnKey ^= Zobrist::pieceKeys[BLACK][p][sq];
       b &= (b - 1);
     }
   }
@@ -274,271 +297,261 @@ int Position::setStartingPosition(std::string startingPosition) {
     mHash ^= Zobrist::sideKey;
   }
 
+  updateCheckInfo();
+  if (nnue::isLoaded()) refreshAccumulator();
+
   return 0;
 }
 
-uint64_t Position::attackGeneration(int square, int type, Color color) {
-  uint64_t attack = 0;
-  if (type == ROOK) {
-    attack = get_rook_attacks(square, occupancies[2]);
-  } else if (type == BISHOP) {
-    attack = get_bishop_attacks(square, occupancies[2]);
-  } else if (type == QUEEN) {
-    attack =
-        (get_rook_attacks(square, occupancies[2]) | get_bishop_attacks(square, occupancies[2]));
-  } else if (type == KING) {
-    attack = attack::kingAttacks[square];
-  } else if (type == KNIGHT) {
-    attack = attack::knightAttacks[square];
+template <int Type>
+inline uint64_t pieceAttacks(int square, uint64_t occupancy) {
+  if constexpr (Type == KNIGHT) {
+    return attack::knightAttacks[square];
+  } else if constexpr (Type == BISHOP) {
+    return get_bishop_attacks(square, occupancy);
+  } else if constexpr (Type == ROOK) {
+    return get_rook_attacks(square, occupancy);
+  } else if constexpr (Type == QUEEN) {
+    return get_bishop_attacks(square, occupancy) | get_rook_attacks(square, occupancy);
   } else {
-    uint64_t extendedOccupancy = occupancies[2];
-    if (mEnPassentSquare != 0) {
-      extendedOccupancy |= mEnPassentSquare;
-    }
-    attack = attack::getPawnAttacks(square, color, extendedOccupancy);
+    return attack::kingAttacks[square];
   }
-  return attack;
 }
 
-uint64_t Position::getPseudoLegalMoves(int square, int type, Color color) {
-  return (attackGeneration(square, type, color) & ~occupancies[color]);
+// Moves a whole bitboard one step; negative steps go down the board
+template <int Step>
+inline uint64_t shift(uint64_t bb) {
+  if constexpr (Step > 0) {
+    return bb << Step;
+  } else {
+    return bb >> -Step;
+  }
 }
 
-void Position::getCaptures(Color color, MoveList& moveList) {
-  Color enemy = (color == WHITE) ? BLACK : WHITE;
-
-  // 1. Define the target mask (Enemy pieces + En Passant square)
-  // We ignore the enemy King for captures (it's illegal to capture the King),
-  // but we can filter that out inside the loop or just assume pseudo-legal generation
-  // handles it if your engine logic requires it.
-  // Standard practice: Don't generate king captures.
-  uint64_t enemies = occupancies[enemy];
-  uint64_t captureMask = enemies;
+inline void addPromotions(int from, int to, MoveList& moveList) {
+  moveList.add({(uint8_t)from, (uint8_t)to, QUEEN, 0, 0}, 0);
+  moveList.add({(uint8_t)from, (uint8_t)to, KNIGHT, 0, 0}, 0);
+  moveList.add({(uint8_t)from, (uint8_t)to, ROOK, 0, 0}, 0);
+  moveList.add({(uint8_t)from, (uint8_t)to, BISHOP, 0, 0}, 0);
+}
 
-  if (mEnPassentSquare != 0) {
-    captureMask |= mEnPassentSquare;
+uint64_t Position::attackGeneration(int square, int type, Color color) {
+  switch (type) {
+    case KNIGHT:
+      return pieceAttacks<KNIGHT>(square, occupancies[2]);
+    case BISHOP:
+      return pieceAttacks<BISHOP>(square, occupancies[2]);
+    case ROOK:
+      return pieceAttacks<ROOK>(square, occupancies[2]);
+    case QUEEN:
+      return pieceAttacks<QUEEN>(square, occupancies[2]);
+    case KING:
+      return pieceAttacks<KING>(square, occupancies[2]);
+    default:
+      return attack::getPawnAttacks(square, color, occupancies[2] | mEnPassentSquare);
   }
+}
 
-  // --- PAWN CAPTURES (Bitwise Optimization) ---
-  uint64_t pawns = pieces[color][PAWN];
-  uint64_t pawnAttacks = 0ULL;
-
-  if (color == WHITE) {
-    // Capture North-East (<< 9) - Exclude H file to avoid wrapping
-    uint64_t ne = (pawns << 9) & NOT_A_FILE;
-    // Capture North-West (<< 7) - Exclude A file
-    uint64_t nw = (pawns << 7) & NOT_H_FILE;
-
-    pawnAttacks = (ne | nw) & captureMask;
-
-    while (pawnAttacks) {
-      int to = __builtin_ctzll(pawnAttacks);
-
-      // Determine which pawn moved.
-      // If we came from NE (to-9), check if a pawn was there.
-      // We must check valid sources.
-
-      int from_ne = to - 9;
-      int from_nw = to - 7;
+uint64_t Position::getPseudoLegalMoves(int square, int type, Color color) {
+  return (attackGeneration(square, type, color) & ~occupancies[color]);
+}
 
-      // Check potential source squares
-      if (to >= 9 && (pawns & (1ULL << from_ne)) && (from_ne % 8 != 7)) {
-        addPawnCaptureMove(from_ne, to, moveList);
+template <Color Us, GenType Type>
+void Position::generatePawnMoves(uint64_t targets, MoveList& moveList) {
+  constexpr Color Them = (Us == WHITE) ? BLACK : WHITE;
+  constexpr int Up = (Us == WHITE) ? 8 : -8;
+  constexpr int UpRight = (Us == WHITE) ? 9 : -7;
+  constexpr int UpLeft = (Us == WHITE) ? 7 : -9;
+  constexpr uint64_t DoublePushRank = (Us == WHITE) ? RANK_3 : RANK_6;
+  constexpr uint64_t PromotionRank = (Us == WHITE) ? RANK_7 : RANK_2;
+
+  int kingSq = __builtin_ctzll(pieces[Us][KING]);
+  uint64_t empty = ~occupancies[2];
+  uint64_t enemies = occupancies[Them] & ~pieces[Them][KING];
+  uint64_t pawns = pieces[Us][PAWN] & ~PromotionRank;
+  uint64_t promoting = pieces[Us][PAWN] & PromotionRank;
+
+  // A pinned pawn may only move along the pin
+  auto pinAllows = [&](int from, int to) {
+    return !(mPinned & (1ULL << from)) || (attack::lineMask[kingSq][from] & (1ULL << to));
+  };
+
+  if constexpr (Type != CAPTURES) {
+    uint64_t single = shift<Up>(pawns) & empty;
+    // A double push may block a check the single push cannot
+    uint64_t twice = shift<Up>(single & DoublePushRank) & empty & targets;
+    single &= targets;
+
+    while (single) {
+      int to = __builtin_ctzll(single);
+      if (pinAllows(to - Up, to)) {
+        moveList.add({(uint8_t)(to - Up), (uint8_t)to, NOPIECE, 0, 0}, 0);
       }
-      // We use 'else if' or just separate checks.
-      // Separate checks are needed if two pawns capture to the same square.
-      if (to >= 7 && (pawns & (1ULL << from_nw)) && (from_nw % 8 != 0)) {
-        addPawnCaptureMove(from_nw, to, moveList);
-      }
-
-      pawnAttacks &= (pawnAttacks - 1);  // Clear LS1B
+      single &= (single - 1);
+    }
+    while (twice) {
+      int to = __builtin_ctzll(twice);
+      int from = to - 2 * Up;
+      if (pinAllows(from, to)) moveList.add({(uint8_t)from, (uint8_t)to, NOPIECE, 0, 0}, 0);
+      twice &= (twice - 1);
     }
-  } else {  // BLACK
-    // Capture South-East (>> 7) - Exclude A file
-    uint64_t se = (pawns >> 7) & NOT_A_FILE;
-    // Capture South-West (>> 9) - Exclude H file
-    uint64_t sw = (pawns >> 9) & NOT_H_FILE;
-
-    pawnAttacks = (se | sw) & captureMask;
-
-    while (pawnAttacks) {
-      int to = __builtin_ctzll(pawnAttacks);
-      int from_se = to + 7;
-      int from_sw = to + 9;
 
-      if (from_se < 64 && (pawns & (1ULL << from_se)) && (from_se % 8 != 0)) {
-        addPawnCaptureMove(from_se, to, moveList);
-      }
-      if (from_sw < 64 && (pawns & (1ULL << from_sw)) && (from_sw % 8 != 7)) {
-        addPawnCaptureMove(from_sw, to, moveList);
-      }
-      pawnAttacks &= (pawnAttacks - 1);
+    // Push promotions count as quiet moves
+    uint64_t pushes = shift<Up>(promoting) & empty & targets;
+    while (pushes) {
+      int to = __builtin_ctzll(pushes);
+      if (pinAllows(to - Up, to)) addPromotions(to - Up, to, moveList);
+      pushes &= (pushes - 1);
     }
   }
 
-  uint64_t attacker = pieces[color][KING];
-  while (attacker) {
-    int from = __builtin_ctzll(attacker);
-
-    uint64_t attacks = attack::kingAttacks[from] & enemies;
-
-    while (attacks) {
-      int to = __builtin_ctzll(attacks);
-      int victim = board[to];
-
-      if (victim != KING) {
-        int score = 0;
-        if (victim != NOPIECE) {
-          static const int victimScores[] = {100, 300, 310, 500, 900, 20000};
-          static const int aggressorScores[] = {100, 300, 310, 500, 900, 20000};
-          score = victimScores[victim] - (aggressorScores[ROOK] / 10) + 10000;
+  if constexpr (Type != QUIETS) {
+    uint64_t captureTargets = enemies & targets;
+    // Shifting right lands off the A file, shifting left off the H file
+    uint64_t right = shift<UpRight>(pieces[Us][PAWN]) & NOT_A_FILE & captureTargets;
+    uint64_t left = shift<UpLeft>(pieces[Us][PAWN]) & NOT_H_FILE & captureTargets;
+
+    while (right) {
+      int to = __builtin_ctzll(right);
+      int from = to - UpRight;
+      if (pinAllows(from, to)) {
+        if ((1ULL << from) & promoting) {
+          addPromotions(from, to, moveList);
+        } else {
+          moveList.add({(uint8_t)from, (uint8_t)to, NOPIECE, 0, 0}, 0);
         }
-        moveList.add({(uint8_t)from, (uint8_t)to, NOPIECE, 0, 0}, score);
       }
-
-      attacks &= (attacks - 1);
+      right &= (right - 1);
     }
-
-    attacker &= (attacker - 1);
-  }
-
-  attacker = pieces[color][KNIGHT];
-  while (attacker) {
-    int from = __builtin_ctzll(attacker);
-
-    uint64_t attacks = attack::knightAttacks[from] & enemies;
-
-    while (attacks) {
-      int to = __builtin_ctzll(attacks);
-      int victim = board[to];
-
-      if (victim != KING) {
-        int score = 0;
-        if (victim != NOPIECE) {
-          static const int victimScores[] = {100, 300, 310, 500, 900, 20000};
-          static const int aggressorScores[] = {100, 300, 310, 500, 900, 20000};
-          score = victimScores[victim] - (aggressorScores[ROOK] / 10) + 10000;
+    while (left) {
+      int to = __builtin_ctzll(left);
+      int from = to - UpLeft;
+      if (pinAllows(from, to)) {
+        if ((1ULL << from) & promoting) {
+          addPromotions(from, to, moveList);
+        } else {
+          moveList.add({(uint8_t)from, (uint8_t)to, NOPIECE, 0, 0}, 0);
         }
-        moveList.add({(uint8_t)from, (uint8_t)to, NOPIECE, 0, 0}, score);
       }
-
-      attacks &= (attacks - 1);
+      left &= (left - 1);
     }
 
-    attacker &= (attacker - 1);
-  }
-
-  attacker = pieces[color][ROOK];
-  while (attacker) {
-    int from = __builtin_ctzll(attacker);
-
-    // OPTIMIZATION: Get attacks and IMMEDIATELY mask with captureMask
-    // This prevents generating quiet moves and then filtering them later.
-    uint64_t attacks = get_rook_attacks(from, occupancies[2]) & enemies;
-
-    while (attacks) {
-      int to = __builtin_ctzll(attacks);
-      int victim = board[to];
-
-      // Note: King capture check should theoretically not be needed if move gen is pseudo-legal
-      // and previous moves were legal, but we keep safety if needed.
-      if (victim != KING) {
-        int score = 0;
-        if (victim != NOPIECE) {
-          static const int victimScores[] = {100, 300, 310, 500, 900, 20000};
-          static const int aggressorScores[] = {100, 300, 310, 500, 900, 20000};
-          score = victimScores[victim] - (aggressorScores[ROOK] / 10) + 10000;
+    // En passant may also answer a check by the pawn it takes; isEnPassantLegal decides
+    if (mEnPassentSquare) {
+      int to = __builtin_ctzll(mEnPassentSquare);
+      uint64_t takers = attack::pawnAttacks[Them][to] & pawns;
+      while (takers) {
+        int from = __builtin_ctzll(takers);
+        if (isEnPassantLegal(from, to)) {
+          moveList.add({(uint8_t)from, (uint8_t)to, NOPIECE, 0, 0}, 0);
         }
-        moveList.add({(uint8_t)from, (uint8_t)to, NOPIECE, 0, 0}, score);
+        takers &= (takers - 1);
       }
-
-      attacks &= (attacks - 1);
     }
-
-    attacker &= (attacker - 1);
   }
+}
 
-  attacker = pieces[color][BISHOP];
-  while (attacker) {
-    int from = __builtin_ctzll(attacker);
-
-    uint64_t attacks = get_bishop_attacks(from, occupancies[2]) & enemies;
-
-    while (attacks) {
-      int to = __builtin_ctzll(attacks);
-      int victim = board[to];
-
-      if (victim != KING) {
-        int score = 0;
-        if (victim != NOPIECE) {
-          static const int victimScores[] = {100, 300, 310, 500, 900, 20000};
-          static const int aggressorScores[] = {100, 300, 310, 500, 900, 20000};
-          score = victimScores[victim] - (aggressorScores[ROOK] / 10) + 10000;
-        }
-        moveList.add({(uint8_t)from, (uint8_t)to, NOPIECE, 0, 0}, score);
+template <Color Us, int Type>
+void Position::generatePieceMoves(uint64_t targets, MoveList& moveList) {
+  constexpr Color Them = (Us == WHITE) ? BLACK : WHITE;
+  int kingSq = __builtin_ctzll(pieces[Us][KING]);
+
+  uint64_t bb = pieces[Us][Type];
+  while (bb) {
+    int from = __builtin_ctzll(bb);
+    uint64_t moves = pieceAttacks<Type>(from, occupancies[2]) & targets;
+
+    if constexpr (Type == KING) {
+      // The king must not hide behind itself from a slider
+      uint64_t occupancy = occupancies[2] ^ (1ULL << from);
+      uint64_t unsafe = 0ULL;
+      for (uint64_t m = moves; m; m &= (m - 1)) {
+        int to = __builtin_ctzll(m);
+        if (attackersTo(to, occupancy) & occupancies[Them]) unsafe |= 1ULL << to;
       }
-
-      attacks &= (attacks - 1);
+      moves &= ~unsafe;
+    } else if (mPinned & (1ULL << from)) {
+      moves &= attack::lineMask[kingSq][from];
     }
 
-    attacker &= (attacker - 1);
+    while (moves) {
+      int to = __builtin_ctzll(moves);
+      moveList.add({(uint8_t)from, (uint8_t)to, NOPIECE, 0, 0}, 0);
+      moves &= (moves - 1);
+    }
+    bb &= (bb - 1);
   }
+}
 
-  attacker = pieces[color][QUEEN];
-  while (attacker) {
-    int from = __builtin_ctzll(attacker);
+template <Color Us>
+void Position::addCastlingMoves(MoveList& moveList) {
+  constexpr Color Them = (Us == WHITE) ? BLACK : WHITE;
+  constexpr int Rank = (Us == WHITE) ? 0 : 56;
+  constexpr int KingSide = (Us == WHITE) ? WHITE_OO : BLACK_OO;
+  constexpr int QueenSide = (Us == WHITE) ? WHITE_OOO : BLACK_OOO;
 
-    uint64_t attacks =
-        (get_rook_attacks(from, occupancies[2]) | get_bishop_attacks(from, occupancies[2])) &
-        enemies;
+  if (mCheckers) return;
 
-    while (attacks) {
-      int to = __builtin_ctzll(attacks);
-      int victim = board[to];
+  // f/g must be empty and safe
+  if ((mCastleRight & KingSide) && !(occupancies[2] & (0x60ULL << Rank)) &&
+      !isSquareAttacked(Rank + 5, Them) && !isSquareAttacked(Rank + 6, Them)) {
+    moveList.add({(uint8_t)(Rank + 4), (uint8_t)(Rank + 6), NOPIECE, 0, 0}, 0);
+  }
+  // b/c/d must be empty, only c/d need to be safe
+  if ((mCastleRight & QueenSide) && !(occupancies[2] & (0x0EULL << Rank)) &&
+      !isSquareAttacked(Rank + 3, Them) && !isSquareAttacked(Rank + 2, Them)) {
+    moveList.add({(uint8_t)(Rank + 4), (uint8_t)(Rank + 2), NOPIECE, 0, 0}, 0);
+  }
+}
 
-      if (victim != KING) {
-        int score = 0;
-        if (victim != NOPIECE) {
-          static const int victimScores[] = {100, 300, 310, 500, 900, 20000};
-          static const int aggressorScores[] = {100, 300, 310, 500, 900, 20000};
-          score = victimScores[victim] - (aggressorScores[ROOK] / 10) + 10000;
-        }
-        moveList.add({(uint8_t)from, (uint8_t)to, NOPIECE, 0, 0}, score);
-      }
+template <Color Us, GenType Type>
+void Position::generate(MoveList& moveList) {
+  constexpr Color Them = (Us == WHITE) ? BLACK : WHITE;
 
-      attacks &= (attacks - 1);
-    }
+  // Where non-king pieces may go; out of check evasionTargets() is the full board
+  uint64_t targets;
+  if constexpr (Type == CAPTURES) {
+    targets = occupancies[Them] & ~pieces[Them][KING];
+  } else if constexpr (Type == QUIETS) {
+    targets = ~occupancies[2];
+  } else {
+    targets = ~occupancies[Us] & ~pieces[Them][KING];
+  }
+  uint64_t kingTargets = targets;
+  if constexpr (Type != ALL) targets &= evasionTargets();
+
+  // Double check leaves nothing but king moves
+  if (targets) {
+    generatePawnMoves<Us, Type>(targets, moveList);
+    generatePieceMoves<Us, KNIGHT>(targets, moveList);
+    generatePieceMoves<Us, BISHOP>(targets, moveList);
+    generatePieceMoves<Us, ROOK>(targets, moveList);
+    generatePieceMoves<Us, QUEEN>(targets, moveList);
+  }
+  generatePieceMoves<Us, KING>(kingTargets, moveList);
 
-    attacker &= (attacker - 1);
+  if constexpr (Type == QUIETS || Type == ALL) addCastlingMoves<Us>(moveList);
+}
+
+template <GenType Type>
+void Position::generate(MoveList& moveList) {
+  if (mSideToMove == WHITE) {
+    generate<WHITE, Type>(moveList);
+  } else {
+    generate<BLACK, Type>(moveList);
   }
 }
 
-// 3. Helper function for adding pawn moves (handling promotions/En Passant)
-inline void Position::addPawnCaptureMove(int from, int to, MoveList& moveList) {
-  int victim = board[to];
-  int score = 0;
-
-  // En Passant Case
-  if (victim == NOPIECE) {  // Must be EP if we are here
-    score = 105 + 10000;    // Value of pawn capture
-    moveList.add({(uint8_t)from, (uint8_t)to, NOPIECE, 0, 0}, score);
-    return;
-  }
-
-  // Normal Capture Score
-  static const int victimScores[] = {100, 300, 310, 500, 900, 20000};
-  score = victimScores[victim] - 10 + 10000;  // Pawn value ~100/10
-
-  // Promotion Check
-  // If target is Rank 0 or Rank 7
-  if (to >= 56 || to <= 7) {
-    score += 9000;  // Promotion bonus
-    moveList.add({(uint8_t)from, (uint8_t)to, QUEEN, 0, 0}, score);
-    moveList.add({(uint8_t)from, (uint8_t)to, KNIGHT, 0, 0}, score);
-    moveList.add({(uint8_t)from, (uint8_t)to, ROOK, 0, 0}, score);
-    moveList.add({(uint8_t)from, (uint8_t)to, BISHOP, 0, 0}, score);
+template void Position::generate<CAPTURES>(MoveList& moveList);
+template void Position::generate<QUIETS>(MoveList& moveList);
+template void Position::generate<EVASIONS>(MoveList& moveList);
+template void Position::generate<ALL>(MoveList& moveList);
+
+void Position::getMoves(MoveList& moveList) {
+  if (mCheckers) {
+    generate<EVASIONS>(moveList);
   } else {
-    moveList.add({(uint8_t)from, (uint8_t)to, NOPIECE, 0, 0}, score);
+    generate<ALL>(moveList);
   }
 }
 
@@ -569,18 +582,255 @@ bool Position::isSquareAttacked(int square, Color sideAttacking) {
   return false;
 }
 
+bool Position::isPseudoLegal(Move m) {
+  if (m.from > 63 || m.to > 63 || !(occupancies[mSideToMove] & (1ULL << m.from))) return false;
+
+  int piece = board[m.from];
+  Color enemy = (mSideToMove == WHITE) ? BLACK : WHITE;
+
+  // Castling is rare: just ask the generator
+  if (piece == KING && abs((int)m.to - (int)m.from) == 2) {
+    MoveList moves;
+    getMoves(moves);
+    for (int i = 0; i < moves.count; i++) {
+      if (moves.moves[i].from == m.from && moves.moves[i].to == m.to) return true;
+    }
+    return false;
+  }
+
+  uint64_t targets = getPseudoLegalMoves(m.from, piece, mSideToMove) & ~pieces[enemy][KING];
+  if (!(targets & (1ULL << m.to))) return false;
+
+  bool promotes = piece == PAWN && (m.to >= 56 || m.to <= 7);
+  return promotes ? (m.promotion >= KNIGHT && m.promotion <= QUEEN) : m.promotion == NOPIECE;
+}
+
+uint64_t Position::attackersTo(int square, uint64_t occupancy) const {
+  return (attack::pawnAttacks[BLACK][square] & pieces[WHITE][PAWN]) |
+         (attack::pawnAttacks[WHITE][square] & pieces[BLACK][PAWN]) |
+         (attack::knightAttacks[square] & (pieces[WHITE][KNIGHT] | pieces[BLACK][KNIGHT])) |
+         (attack::kingAttacks[square] & (pieces[WHITE][KING] | pieces[BLACK][KING])) |
+         (get_bishop_attacks(square, occupancy) &
+          (pieces[WHITE][BISHOP] | pieces[BLACK][BISHOP] | pieces[WHITE][QUEEN] |
+           pieces[BLACK][QUEEN])) |
+         (get_rook_attacks(square, occupancy) &
+          (pieces[WHITE][ROOK] | pieces[BLACK][ROOK] | pieces[WHITE][QUEEN] |
+           pieces[BLACK][QUEEN]));
+}
+
+void Position::updateCheckInfo() {
+  Color us = mSideToMove;
+  Color enemy = (us == WHITE) ? BLACK : WHITE;
+  int kingSq = __builtin_ctzll(pieces[us][KING]);
+
+  mCheckers = attackersTo(kingSq, occupancies[2]) & occupancies[enemy];
+
+  // Enemy sliders that would hit our king on an empty board; exactly one piece in
+  // between, and ours, makes a pin
+  uint64_t snipers =
+      (get_rook_attacks(kingSq, 0ULL) & (pieces[enemy][ROOK] | pieces[enemy][QUEEN])) |
+      (get_bishop_attacks(kingSq, 0ULL) & (pieces[enemy][BISHOP] | pieces[enemy][QUEEN]));
+
+  mPinned = 0ULL;
+  while (snipers) {
+    int sniperSq = __builtin_ctzll(snipers);
+    uint64_t blockers = attack::betweenMask[kingSq][sniperSq] & occupancies[2];
+    if (blockers && !(blockers & (blockers - 1))) mPinned |= blockers & occupancies[us];
+    snipers &= (snipers - 1);
+  }
+}
+
+void Position::refreshAccumulator() { nnue::refresh(mAccumulator, pieces); }
+
+void Position::updateAccumulator(Color us, Move m, const StateInfo& st, bool undo) {
+  Color them = (us == WHITE) ? BLACK : WHITE;
+  nnue::Feature added[2], removed[2];
+  int addedCount = 0, removedCount = 0;
+
+  removed[removedCount++] = {us, st.movedPiece, m.from};
+  added[addedCount++] = {us, m.promotion != NOPIECE ? m.promotion : st.movedPiece, m.to};
+
+  if (st.capturedPiece != NOPIECE) {
+    int capturedSq = m.to;
+    if (st.movedPiece == PAWN && (1ULL << m.to) == st.epSquare) {
+      capturedSq = m.to + ((us == WHITE) ? -8 : 8);
+    }
+    removed[removedCount++] = {them, st.capturedPiece, capturedSq};
+  } else if (st.movedPiece == KING && abs((int)m.to - (int)m.from) == 2) {
+    bool kingSide = m.to > m.from;
+    removed[removedCount++] = {us, ROOK, kingSide ? m.to + 1 : m.to - 2};
+    added[addedCount++] = {us, ROOK, kingSide ? m.to - 1 : m.to + 1};
+  }
+
+  if (undo) {
+    nnue::update(mAccumulator, removed, removedCount, added, addedCount);
+  } else {
+    nnue::update(mAccumulator, added, addedCount, removed, removedCount);
+  }
+}
+
+uint64_t Position::evasionTargets() const {
+  if (!mCheckers) return ~0ULL;
+  // Double check: only the king can move
+  if (mCheckers & (mCheckers - 1)) return 0ULL;
+
+  int kingSq = __builtin_ctzll(pieces[mSideToMove][KING]);
+  return attack::betweenMask[kingSq][__builtin_ctzll(mCheckers)] | mCheckers;
+}
+
+bool Position::isEnPassantLegal(int from, int to) const {
+  Color enemy = (mSideToMove == WHITE) ? BLACK : WHITE;
+  int kingSq = __builtin_ctzll(pieces[mSideToMove][KING]);
+  int capturedSq = to + ((mSideToMove == WHITE) ? -8 : 8);
+  uint64_t capturedMask = 1ULL << capturedSq;
+
+  // Two pieces leave the king's lines at once (including along the rank), so the
+  // pin mask is not enough: test the resulting occupancy
+  uint64_t occupancy = (occupancies[2] ^ (1ULL << from) ^ capturedMask) | (1ULL << to);
+  return !(attackersTo(kingSq, occupancy) & occupancies[enemy] & ~capturedMask);
+}
+
+int Position::see(Move m) const {
+  int to = m.to;
+  uint64_t occupancy = occupancies[2];
+  uint64_t diagonal = pieces[WHITE][BISHOP] | pieces[BLACK][BISHOP] | pieces[WHITE][QUEEN] |
+                      pieces[BLACK][QUEEN];
+  uint64_t straight =
+      pieces[WHITE][ROOK] | pieces[BLACK][ROOK] | pieces[WHITE][QUEEN] | pieces[BLACK][QUEEN];
+
+  int attacker = board[m.from];
+  int victim = board[to];
+  if (attacker == PAWN && (1ULL << to) == mEnPassentSquare) {
+    victim = PAWN;
+    occupancy ^= 1ULL << (to + ((mSideToMove == WHITE) ? -8 : 8));
+  }
+
+  // gain[d]: what the side making capture d has won if the sequence stopped there
+  int gain[32];
+  int d = 0;
+  gain[0] = (victim == NOPIECE) ? 0 : pieceValues[victim];
+  if (m.promotion != NOPIECE) {
+    gain[0] += pieceValues[m.promotion] - pieceValues[PAWN];
+    attacker = m.promotion;
+  }
+
+  uint64_t fromMask = 1ULL << m.from;
+  uint64_t attackers = attackersTo(to, occupancy);
+  Color side = mSideToMove;
+
+  while (true) {
+    d++;
+    // Speculative: assume the piece just moved to 'to' gets taken
+    gain[d] = pieceValues[attacker] - gain[d - 1];
+    // Neither side can improve by continuing
+    if (std::max(-gain[d - 1], gain[d]) < 0) break;
+
+    occupancy ^= fromMask;
+    // Sliders lined up behind the piece that just captured join in (x-rays)
+    if (attacker == PAWN || attacker == BISHOP || attacker == QUEEN) {
+      attackers |= get_bishop_attacks(to, occupancy) & diagonal;
+    }
+    if (attacker == ROOK || attacker == QUEEN) {
+      attackers |= get_rook_attacks(to, occupancy) & straight;
+    }
+    attackers &= occupancy;
+
+    side = (side == WHITE) ? BLACK : WHITE;
+    uint64_t ours = attackers & occupancies[side];
+    if (!ours) break;
+
+    int type = PAWN;
+    while (!(pieces[side][type] & ours)) type++;
+    // The king may only take last
+    if (type == KING && (attackers & occupancies[side == WHITE ? BLACK : WHITE])) break;
+
+    fromMask = pieces[side][type] & ours;
+    fromMask &= -fromMask;
+    attacker = type;
+  }
+
+  while (--d) gain[d - 1] = -std::max(-gain[d - 1], gain[d]);
+  return gain[0];
+}
+
+uint64_t Position::seeBenchmark(int milliseconds) {
+  static const char* fens[] = {
+      "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+      "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+      "2r2rk1/1bqnbpp1/1p1ppn1p/pP6/N1P1P3/P2B1N1P/1B2QPP1/R2R2K1 b - - 0 1",
+      "r1b2rk1/2q1b1pp/p2ppn2/1p6/3QP3/1BN1B3/PPP3PP/R4RK1 w - - 0 1",
+      "3rr1k1/pp3pp1/1qn2np1/8/3p4/PP1R1P2/2P1NQPP/R1B3K1 b - - 0 1",
+      "1k1r3r/pp2qpp1/3b1n1p/3pNQ2/2pP1P2/2N1P3/PP4PP/1K1RR3 b - - 0 1"};
+
+  std::vector<Position> positions(std::size(fens));
+  std::vector<MoveList> captures(std::size(fens));
+  for (size_t i = 0; i < std::size(fens); i++) {
+    positions[i].setStartingPosition(fens[i]);
+    positions[i].generate<CAPTURES>(captures[i]);
+  }
+
+  uint64_t calls = 0;
+  int64_t checksum = 0;  // Keeps the calls from being optimised away
+  auto start = std::chrono::steady_clock::now();
+  auto deadline = start + std::chrono::milliseconds(milliseconds);
+
+  while (std::chrono::steady_clock::now() < deadline) {
+    for (int rep = 0; rep < 1000; rep++) {
+      for (size_t i = 0; i < positions.size(); i++) {
+        for (int j = 0; j < captures[i].count; j++) {
+          checksum += positions[i].see(captures[i].moves[j]);
+        }
+        calls += captures[i].count;
+      }
+    }
+  }
+
+  long long elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+  std::cout << "info string see calls " << calls << " time " << elapsed << " calls/s "
+            << calls * 1000 / std::max(1LL, elapsed) << " checksum " << checksum << std::endl;
+  return calls;
+}
+
+bool Position::isLegal(Move m) {
+  int piece = board[m.from];
+
+  if (piece == KING) {
+    // Castling through or out of check is already refused by the generator
+    if (abs((int)m.to - (int)m.from) == 2) return true;
+    Color enemy = (mSideToMove == WHITE) ? BLACK : WHITE;
+    return !(attackersTo(m.to, occupancies[2] ^ (1ULL << m.from)) & occupancies[enemy]);
+  }
+
+  if (piece == PAWN && (1ULL << m.to) == mEnPassentSquare) return isEnPassantLegal(m.from, m.to);
+
+  if (!(evasionTargets() & (1ULL << m.to))) return false;
+
+  if (mPinned & (1ULL << m.from)) {
+    int kingSq = __builtin_ctzll(pieces[mSideToMove][KING]);
+    return attack::lineMask[kingSq][m.from] & (1ULL << m.to);
+  }
+  return true;
+}
+
+template <Color Us>
 void Position::doMove(Move m) {
+  constexpr Color Them = (Us == WHITE) ? BLACK : WHITE;
+
   StateInfo state;
   state.castle = mCastleRight;
   state.epSquare = mEnPassentSquare;
   state.halfMove = mHalfMove;
   state.psqtScore = posEval.positionScore;
   state.zobristKey = mHash;
+  state.pawnKey = mPawnKey;
+  state.materialKey = mMaterialKey;
+  state.checkers = mCheckers;
+  state.pinned = mPinned;
   state.movedPiece = board[m.from];
   state.capturedPiece = NOPIECE;
 
-  Color enemy = (mSideToMove == WHITE) ? BLACK : WHITE;
-
   // Pre-compute masks
   uint64_t fromMask = 1ULL << m.from;
   uint64_t toMask = 1ULL << m.to;
@@ -592,19 +842,23 @@ void Position::doMove(Move m) {
   }
   mHash ^= Zobrist::castleKeys[mCastleRight];
   mHash ^= Zobrist::sideKey;
-  mHash ^= Zobrist::pieceKeys[mSideToMove][state.movedPiece][m.from];
+  mHash ^= Zobrist::pieceKeys[Us][state.movedPiece][m.from];
+  if (state.movedPiece == PAWN) mPawnKey ^= Zobrist::pieceKeys[Us][PAWN][m.from];
 
   // Update PSQT score - remove piece from source
-  posEval.positionScore -= getPieceValue(state.movedPiece, m.from, mSideToMove);
+  posEval.positionScore -= getPieceValue(state.movedPiece, m.from, Us);
 
   // Handle capture
   if (board[m.to] != NOPIECE) {
     state.capturedPiece = board[m.to];
-    pieces[enemy][state.capturedPiece] ^= toMask;
-    occupancies[enemy] ^= toMask;
+    pieces[Them][state.capturedPiece] ^= toMask;
+    occupancies[Them] ^= toMask;
     occupancies[2] ^= toMask;
-    posEval.positionScore -= getPieceValue(state.capturedPiece, m.to, enemy);
-    mHash ^= Zobrist::pieceKeys[enemy][state.capturedPiece][m.to];
+    posEval.positionScore -= getPieceValue(state.capturedPiece, m.to, Them);
+    mHash ^= Zobrist::pieceKeys[Them][state.capturedPiece][m.to];
+    if (state.capturedPiece == PAWN) mPawnKey ^= Zobrist::pieceKeys[Them][PAWN][m.to];
+    int left = __builtin_popcountll(pieces[Them][state.capturedPiece]);
+    mMaterialKey ^= Zobrist::pieceKeys[Them][state.capturedPiece][left];
     mHalfMove = 0;
   } else if (state.movedPiece == PAWN) {
     mHalfMove = 0;
@@ -614,29 +868,33 @@ void Position::doMove(Move m) {
 
   // Handle promotion
   if (m.promotion != NOPIECE) {
-    pieces[mSideToMove][PAWN] ^= fromMask;
-    pieces[mSideToMove][m.promotion] ^= toMask;
-    occupancies[mSideToMove] ^= moveMask;
+    pieces[Us][PAWN] ^= fromMask;
+    pieces[Us][m.promotion] ^= toMask;
+    occupancies[Us] ^= moveMask;
     occupancies[2] ^= moveMask;
 
     board[m.from] = NOPIECE;
     board[m.to] = m.promotion;
 
-    posEval.positionScore += getPieceValue(m.promotion, m.to, mSideToMove);
-    mHash ^= Zobrist::pieceKeys[mSideToMove][m.promotion][m.to];
+    posEval.positionScore += getPieceValue(m.promotion, m.to, Us);
+    mHash ^= Zobrist::pieceKeys[Us][m.promotion][m.to];
+    int pawnsLeft = __builtin_popcountll(pieces[Us][PAWN]);
+    int promoted = __builtin_popcountll(pieces[Us][m.promotion]);
+    mMaterialKey ^= Zobrist::pieceKeys[Us][PAWN][pawnsLeft];
+    mMaterialKey ^= Zobrist::pieceKeys[Us][m.promotion][promoted - 1];
     mEnPassentSquare = 0;
   }
   // Handle normal moves
   else {
-    pieces[mSideToMove][state.movedPiece] ^= moveMask;
-    occupancies[mSideToMove] ^= moveMask;
+    pieces[Us][state.movedPiece] ^= moveMask;
+    occupancies[Us] ^= moveMask;
     occupancies[2] ^= moveMask;
 
     board[m.from] = NOPIECE;
     board[m.to] = state.movedPiece;
 
-    posEval.positionScore += getPieceValue(state.movedPiece, m.to, mSideToMove);
-    mHash ^= Zobrist::pieceKeys[mSideToMove][state.movedPiece][m.to];
+    posEval.positionScore += getPieceValue(state.movedPiece, m.to, Us);
+    mHash ^= Zobrist::pieceKeys[Us][state.movedPiece][m.to];
 
     // Handle castling
     if (state.movedPiece == KING) {
@@ -648,17 +906,17 @@ void Position::doMove(Move m) {
 
         uint64_t rookMask = (1ULL << rookIdx) | (1ULL << rookDest);
 
-        pieces[mSideToMove][ROOK] ^= rookMask;
-        occupancies[mSideToMove] ^= rookMask;
+        pieces[Us][ROOK] ^= rookMask;
+        occupancies[Us] ^= rookMask;
         occupancies[2] ^= rookMask;
 
         board[rookIdx] = NOPIECE;
         board[rookDest] = ROOK;
 
-        posEval.positionScore -= getPieceValue(ROOK, rookIdx, mSideToMove);
-        posEval.positionScore += getPieceValue(ROOK, rookDest, mSideToMove);
-        mHash ^= Zobrist::pieceKeys[mSideToMove][ROOK][rookIdx];
-        mHash ^= Zobrist::pieceKeys[mSideToMove][ROOK][rookDest];
+        posEval.positionScore -= getPieceValue(ROOK, rookIdx, Us);
+        posEval.positionScore += getPieceValue(ROOK, rookDest, Us);
+        mHash ^= Zobrist::pieceKeys[Us][ROOK][rookIdx];
+        mHash ^= Zobrist::pieceKeys[Us][ROOK][rookDest];
       }
       mEnPassentSquare = 0;
     }
@@ -666,20 +924,24 @@ void Position::doMove(Move m) {
     else if (state.movedPiece == PAWN) {
       // Handle en passant capture
       if (toMask == mEnPassentSquare && mEnPassentSquare != 0) {
-        int captureOffset = (mSideToMove == WHITE) ? -8 : 8;
+        constexpr int captureOffset = (Us == WHITE) ? -8 : 8;
         int captureSq = m.to + captureOffset;
         uint64_t captureMask = 1ULL << captureSq;
 
         state.capturedPiece = PAWN;
-        pieces[enemy][PAWN] ^= captureMask;
-        occupancies[enemy] ^= captureMask;
+        pieces[Them][PAWN] ^= captureMask;
+        occupancies[Them] ^= captureMask;
         occupancies[2] ^= captureMask;
         board[captureSq] = NOPIECE;
 
-        posEval.positionScore -= getPieceValue(PAWN, captureSq, enemy);
-        mHash ^= Zobrist::pieceKeys[enemy][PAWN][captureSq];
+        posEval.positionScore -= getPieceValue(PAWN, captureSq, Them);
+        mHash ^= Zobrist::pieceKeys[Them][PAWN][captureSq];
+        mPawnKey ^= Zobrist::pieceKeys[Them][PAWN][captureSq];
+        mMaterialKey ^= Zobrist::pieceKeys[Them][PAWN][__builtin_popcountll(pieces[Them][PAWN])];
       }
 
+      mPawnKey ^= Zobrist::pieceKeys[Us][PAWN][m.to];
+
       // Set new en passant square for double pawn push
       if (abs((int)m.to - (int)m.from) == 16) {
         int epSq = (m.from + m.to) / 2;
@@ -702,16 +964,25 @@ void Position::doMove(Move m) {
   }
   mHash ^= Zobrist::castleKeys[mCastleRight];
 
+  if (nnue::isLoaded()) updateAccumulator(Us, m, state, false);
+
   // Switch side
-  mSideToMove = enemy;
+  mSideToMove = Them;
+  updateCheckInfo();
 
   history[gamePly] = state;
 
-  history[gamePly].evalCache.invalidate();
-
   gamePly++;
 }
 
+void Position::doMove(Move m) {
+  if (mSideToMove == WHITE) {
+    doMove<WHITE>(m);
+  } else {
+    doMove<BLACK>(m);
+  }
+}
+
 void Position::doNullMove() {
   StateInfo state;
   state.castle = mCastleRight;
@@ -719,6 +990,10 @@ void Position::doNullMove() {
   state.halfMove = mHalfMove;
   state.psqtScore = posEval.positionScore;
   state.zobristKey = mHash;
+  state.pawnKey = mPawnKey;
+  state.materialKey = mMaterialKey;
+  state.checkers = mCheckers;
+  state.pinned = mPinned;
   state.movedPiece = NOPIECE;
   state.capturedPiece = NOPIECE;
 
@@ -731,30 +1006,38 @@ void Position::doNullMove() {
 
   mEnPassentSquare = 0;
   mSideToMove = enemy;
+  updateCheckInfo();
 
   // Update 50-move rule (Null move counts as a ply without pawn move/capture)
   mHalfMove++;
 
   history[gamePly] = state;
-  history[gamePly].evalCache.invalidate();
 
   gamePly++;
 }
 
+template <Color Us>
 void Position::undoMove(Move m) {
+  constexpr Color Them = (Us == WHITE) ? BLACK : WHITE;
+
   gamePly--;
   // Restore state from history
   const StateInfo& state = history[gamePly];
 
+  if (nnue::isLoaded()) updateAccumulator(Us, m, state, true);
+
   mCastleRight = state.castle;
   mEnPassentSquare = state.epSquare;
   mHalfMove = state.halfMove;
   mHash = state.zobristKey;
+  mPawnKey = state.pawnKey;
+  mMaterialKey = state.materialKey;
+  mCheckers = state.checkers;
+  mPinned = state.pinned;
   posEval.positionScore = state.psqtScore;
 
   // Switch side back
-  mSideToMove = (mSideToMove == WHITE) ? BLACK : WHITE;
-  Color enemy = (mSideToMove == WHITE) ? BLACK : WHITE;
+  mSideToMove = Us;
 
   // Pre-compute masks
   uint64_t fromMask = 1ULL << m.from;
@@ -763,9 +1046,9 @@ void Position::undoMove(Move m) {
 
   // Handle promotion undo
   if (m.promotion != NOPIECE) {
-    pieces[mSideToMove][m.promotion] ^= toMask;
-    pieces[mSideToMove][PAWN] ^= fromMask;
-    occupancies[mSideToMove] ^= moveMask;
+    pieces[Us][m.promotion] ^= toMask;
+    pieces[Us][PAWN] ^= fromMask;
+    occupancies[Us] ^= moveMask;
     occupancies[2] ^= moveMask;
 
     board[m.to] = NOPIECE;
@@ -773,8 +1056,8 @@ void Position::undoMove(Move m) {
   }
   // Handle normal move undo
   else {
-    pieces[mSideToMove][state.movedPiece] ^= moveMask;
-    occupancies[mSideToMove] ^= moveMask;
+    pieces[Us][state.movedPiece] ^= moveMask;
+    occupancies[Us] ^= moveMask;
     occupancies[2] ^= moveMask;
 
     board[m.to] = NOPIECE;
@@ -786,16 +1069,16 @@ void Position::undoMove(Move m) {
 
       if (castleDelta == 2) {  // Kingside
         uint64_t rookMoveMask = (1ULL << (m.to + 1)) | (1ULL << (m.to - 1));
-        pieces[mSideToMove][ROOK] ^= rookMoveMask;
-        occupancies[mSideToMove] ^= rookMoveMask;
+        pieces[Us][ROOK] ^= rookMoveMask;
+        occupancies[Us] ^= rookMoveMask;
         occupancies[2] ^= rookMoveMask;
 
         board[m.to - 1] = NOPIECE;
         board[m.to + 1] = ROOK;
       } else if (castleDelta == -2) {  // Queenside
         uint64_t rookMoveMask = (1ULL << (m.to - 2)) | (1ULL << (m.to + 1));
-        pieces[mSideToMove][ROOK] ^= rookMoveMask;
-        occupancies[mSideToMove] ^= rookMoveMask;
+        pieces[Us][ROOK] ^= rookMoveMask;
+        occupancies[Us] ^= rookMoveMask;
         occupancies[2] ^= rookMoveMask;
 
         board[m.to + 1] = NOPIECE;
@@ -808,25 +1091,34 @@ void Position::undoMove(Move m) {
   if (state.capturedPiece != NOPIECE) {
     // Handle en passant capture undo
     if (state.movedPiece == PAWN && toMask == state.epSquare) {
-      int captureOffset = (mSideToMove == WHITE) ? -8 : 8;
+      constexpr int captureOffset = (Us == WHITE) ? -8 : 8;
       int captureSq = m.to + captureOffset;
       uint64_t captureMask = 1ULL << captureSq;
 
-      pieces[enemy][PAWN] ^= captureMask;
-      occupancies[enemy] ^= captureMask;
+      pieces[Them][PAWN] ^= captureMask;
+      occupancies[Them] ^= captureMask;
       occupancies[2] ^= captureMask;
       board[captureSq] = PAWN;
     }
     // Handle normal capture undo
     else {
-      pieces[enemy][state.capturedPiece] ^= toMask;
-      occupancies[enemy] ^= toMask;
+      pieces[Them][state.capturedPiece] ^= toMask;
+      occupancies[Them] ^= toMask;
       occupancies[2] ^= toMask;
       board[m.to] = state.capturedPiece;
     }
   }
 }
 
+void Position::undoMove(Move m) {
+  // The side that made the move is the one not to move now
+  if (mSideToMove == BLACK) {
+    undoMove<WHITE>(m);
+  } else {
+    undoMove<BLACK>(m);
+  }
+}
+
 void Position::undoNullMove() {
   gamePly--;
   const StateInfo& state = history[gamePly];
@@ -835,79 +1127,15 @@ void Position::undoNullMove() {
   mEnPassentSquare = state.epSquare;
   mHalfMove = state.halfMove;
   mHash = state.zobristKey;
+  mPawnKey = state.pawnKey;
+  mMaterialKey = state.materialKey;
+  mCheckers = state.checkers;
+  mPinned = state.pinned;
   posEval.positionScore = state.psqtScore;
 
   mSideToMove = (mSideToMove == WHITE) ? BLACK : WHITE;
 }
 
-void Position::getMoves(Color color, MoveList& moveList) {
-  Color enemy = (color == WHITE) ? BLACK : WHITE;
-  uint64_t enemyKing = pieces[enemy][KING];
-
-  for (int i = 0; i < 6; i++) {
-    uint64_t piece = pieces[color][i];
-    while (piece) {
-      int sourceSquare = __builtin_ctzll(piece);
-      uint64_t validTargets = getPseudoLegalMoves(sourceSquare, i, color);
-      validTargets &= ~enemyKing;
-
-      while (validTargets) {
-        int targetSquare = __builtin_ctzll(validTargets);
-        int victim = board[targetSquare];
-        int aggressor = i;
-        int score = 0;
-
-        if (victim != NOPIECE) {
-          static const int victimScores[] = {100, 300, 310, 500, 900, 0};
-          score = victimScores[victim] - victimScores[aggressor] + 10000;
-        }
-
-        if (i == PAWN && (targetSquare / 8) == ((color == WHITE) ? 7 : 0)) {
-          moveList.add({(uint8_t)sourceSquare, (uint8_t)targetSquare, QUEEN, 0, 0}, score);
-          moveList.add({(uint8_t)sourceSquare, (uint8_t)targetSquare, KNIGHT, 0, 0}, score);
-          moveList.add({(uint8_t)sourceSquare, (uint8_t)targetSquare, BISHOP, 0, 0}, score);
-          moveList.add({(uint8_t)sourceSquare, (uint8_t)targetSquare, ROOK, 0, 0}, score);
-        } else {
-          moveList.add({(uint8_t)sourceSquare, (uint8_t)targetSquare, NOPIECE, 0, 0}, score);
-        }
-        validTargets &= (validTargets - 1);
-      }
-      piece &= (piece - 1);
-    }
-  }
-  if (color == WHITE) {
-    if ((mCastleRight & WHITE_OO) && !(occupancies[2] & ((1ULL << 5) | (1ULL << 6)))) {
-      if (!isSquareAttacked(4, BLACK) && !isSquareAttacked(5, BLACK) &&
-          !isSquareAttacked(6, BLACK)) {
-        moveList.add({4, 6, NOPIECE, 0, 0}, 0);  // e1g1
-      }
-    }
-
-    if ((mCastleRight & WHITE_OOO) &&
-        !(occupancies[2] & ((1ULL << 1) | (1ULL << 2) | (1ULL << 3)))) {
-      if (!isSquareAttacked(4, BLACK) && !isSquareAttacked(3, BLACK) &&
-          !isSquareAttacked(2, BLACK)) {
-        moveList.add({4, 2, NOPIECE, 0, 0}, 0);  // e1c1
-      }
-    }
-  } else {
-    if ((mCastleRight & BLACK_OO) && !(occupancies[2] & ((1ULL << 61) | (1ULL << 62)))) {
-      if (!isSquareAttacked(60, WHITE) && !isSquareAttacked(61, WHITE) &&
-          !isSquareAttacked(62, WHITE)) {
-        moveList.add({60, 62, NOPIECE, 0, 0}, 0);  // e8g8
-      }
-    }
-
-    if ((mCastleRight & BLACK_OOO) &&
-        !(occupancies[2] & ((1ULL << 57) | (1ULL << 58) | (1ULL << 59)))) {
-      if (!isSquareAttacked(60, WHITE) && !isSquareAttacked(59, WHITE) &&
-          !isSquareAttacked(58, WHITE)) {
-        moveList.add({60, 58, NOPIECE, 0, 0}, 0);  // e8c8
-      }
-    }
-  }
-}
-
 void Position::printBoard() {
   std::cout << "         board" << std::endl;
   std::cout << "  +-----------------+" << std::endl;
@@ -954,8 +1182,6 @@ void Position::printBoard() {
 }
 
 Position::Position() {
-  Zobrist::init();
-  initPST();
   gamePly = 0;
 
   for (int c = 0; c < 2; c++) {
@@ -0,0 +1,349 @@
+#include "../include/tablebase.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+
+#include "../include/position.hpp"
+
+namespace tablebase {
+
+namespace {
+
+const char MAGIC[8] = {'B', 'B', 'X', 'W', 'D', 'L', '1', '\0'};
+const char PIECE_CHARS[] = "PNBRQK";
+
+struct Header {
+  char magic[8];
+  uint32_t positions;
+  uint32_t blocks;
+};
+
+struct Table {
+  Material material;
+  const unsigned char* map;
+  size_t bytes;
+  uint32_t blocks;
+  const uint32_t* offsets;
+  const unsigned char* data;
+};
+
+std::unordered_map<std::string, Table> tables;
+int largest = 0;
+
+// Up to two non-king pieces of one side as a number below SIDE_CODES, in any order
+constexpr int SIDE_CODES = 36;
+
+int sideCode(const int* piece, const Color* color, int count, Color side) {
+  int high = 0, low = 0;  // Piece + 1, 0 for none
+  for (int i = 0; i < count; i++) {
+    if (color[i] != side || piece[i] == KING) continue;
+    int p = piece[i] + 1;
+    if (p > high) {
+      low = high;
+      high = p;
+    } else if (p > low) {
+      low = p;
+    }
+  }
+  return high * 6 + low;
+}
+
+// Loaded tables by the material of the probed position (White's side code, then
+// Black's), built by init so a probe needs no allocation or string lookup. 'flip' is
+// set when the position has the stronger side as Black and its colours must be swapped.
+struct Slot {
+  const Table* table = nullptr;
+  bool flip = false;
+};
+std::array<Slot, SIDE_CODES * SIDE_CODES> byMaterial;
+
+// a1-d1-d4 triangle, the White king's squares in pawnless tables
+constexpr int TRIANGLE[10] = {0, 1, 2, 3, 9, 10, 11, 18, 19, 27};
+
+int triangleIndex(int sq) {
+  for (int i = 0; i < 10; i++) {
+    if (TRIANGLE[i] == sq) return i;
+  }
+  return -1;
+}
+
+int flipDiagonal(int sq) { return ((sq & 7) << 3) | (sq >> 3); }
+
+void unloadAll() {
+  for (auto& [name, table] : tables) munmap((void*)table.map, table.bytes);
+  tables.clear();
+  byMaterial.fill(Slot());
+  largest = 0;
+}
+
+bool mapTable(const std::string& path, const std::string& name) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(Header)) {
+    close(fd);
+    return false;
+  }
+  void* data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) return false;
+
+  Table table{Material(name), (const unsigned char*)data, (size_t)st.st_size, 0, nullptr,
+              nullptr};
+  Header header;
+  std::memcpy(&header, data, sizeof(header));
+  size_t dataStart = sizeof(Header) + (header.blocks + 1) * sizeof(uint32_t);
+  if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+      header.positions != table.material.size() ||
+      header.blocks != (header.positions + BLOCK_SIZE - 1) / BLOCK_SIZE ||
+      dataStart > table.bytes) {
+    munmap(data, table.bytes);
+    return false;
+  }
+
+  table.blocks = header.blocks;
+  table.offsets = (const uint32_t*)(table.map + sizeof(Header));
+  table.data = table.map + dataStart;
+  if (dataStart + table.offsets[table.blocks] > table.bytes) {
+    munmap(data, table.bytes);
+    return false;
+  }
+
+  largest = std::max(largest, table.material.count);
+  tables.emplace(name, table);
+  return true;
+}
+
+Stored lookup(const Table& table, uint64_t index) {
+  const unsigned char* p = table.data + table.offsets[index / BLOCK_SIZE];
+  uint64_t offset = index % BLOCK_SIZE;
+
+  while (true) {
+    int value = *p >> 6;
+    uint64_t run = *p & 63;
+    p++;
+    if (run < 63) {
+      run += 1;
+    } else {
+      run = 0;
+      for (int shift = 0;; shift += 7) {
+        run |= (uint64_t)(*p & 127) << shift;
+        if (!(*p++ & 128)) break;
+      }
+      run += 64;
+    }
+    if (offset < run) return (Stored)value;
+    offset -= run;
+  }
+}
+
+void emitRun(std::vector<unsigned char>& out, int value, uint64_t run) {
+  if (run < 64) {
+    out.push_back((unsigned char)(value << 6 | (run - 1)));
+    return;
+  }
+  out.push_back((unsigned char)(value << 6 | 63));
+  run -= 64;
+  do {
+    unsigned char byte = run & 127;
+    run >>= 7;
+    out.push_back(byte | (run ? 128 : 0));
+  } while (run);
+}
+
+}  // namespace
+
+Material::Material(const std::string& tableName) : name(tableName) {
+  size_t split = tableName.find('v');
+  for (size_t i = 0; i < tableName.size() && count < MAX_PIECES; i++) {
+    if (i == split || tableName[i] == 'K') continue;
+    piece[count + 2] = (int)(std::strchr(PIECE_CHARS, tableName[i]) - PIECE_CHARS);
+    color[count + 2] = i < split ? WHITE : BLACK;
+    hasPawns |= piece[count + 2] == PAWN;
+    count++;
+  }
+  piece[0] = piece[1] = KING;
+  color[0] = WHITE;
+  color[1] = BLACK;
+  count += 2;
+}
+
+uint64_t Material::size() const {
+  uint64_t positions = 2 * (hasPawns ? 32 : 10);
+  for (int i = 1; i < count; i++) positions *= 64;
+  return positions;
+}
+
+uint64_t Material::index(const int* squares, Color sideToMove) const {
+  int sq[MAX_PIECES];
+  std::copy(squares, squares + count, sq);
+
+  if (sq[0] % 8 > 3) {
+    for (int i = 0; i < count; i++) sq[i] ^= 7;
+  }
+  if (!hasPawns) {
+    if (sq[0] / 8 > 3) {
+      for (int i = 0; i < count; i++) sq[i] ^= 56;
+    }
+    if (sq[0] / 8 > sq[0] % 8) {
+      for (int i = 0; i < count; i++) sq[i] = flipDiagonal(sq[i]);
+    }
+  }
+
+  uint64_t index = 0;
+  for (int i = count - 1; i > 0; i--) index = index * 64 + sq[i];
+  int king = hasPawns ? (sq[0] / 8) * 4 + sq[0] % 8 : triangleIndex(sq[0]);
+  return sideToMove + 2 * (king + (hasPawns ? 32 : 10) * index);
+}
+
+void Material::decode(uint64_t index, int* squares, Color& sideToMove) const {
+  sideToMove = Color(index & 1);
+  index >>= 1;
+  int kingSlots = hasPawns ? 32 : 10;
+  int king = (int)(index % kingSlots);
+  index /= kingSlots;
+  squares[0] = hasPawns ? (king / 4) * 8 + king % 4 : TRIANGLE[king];
+  for (int i = 1; i < count; i++) {
+    squares[i] = (int)(index % 64);
+    index /= 64;
+  }
+}
+
+std::vector<std::string> allTables() {
+  const std::string pieces = "QRBNP";
+  std::vector<std::string> names;
+  for (char a : pieces) names.push_back(std::string("K") + a + "vK");
+  for (size_t i = 0; i < pieces.size(); i++) {
+    for (size_t j = i; j < pieces.size(); j++) {
+      names.push_back(std::string("K") + pieces[i] + pieces[j] + "vK");
+      names.push_back(std::string("K") + pieces[i] + "vK" + pieces[j]);
+    }
+  }
+  return names;
+}
+
+int init(const std::string& dir) {
+  unloadAll();
+  if (dir.empty() || dir == "<empty>") return 0;
+
+  for (const std::string& name : allTables()) mapTable(dir + "/" + name + ".wdl", name);
+
+  // Each table under its own material and, colours swapped, under the mirrored one. A
+  // material equal on both sides keeps the unswapped entry.
+  for (const auto& [name, table] : tables) {
+    const Material& m = table.material;
+    int white = sideCode(m.piece, m.color, m.count, WHITE);
+    int black = sideCode(m.piece, m.color, m.count, BLACK);
+    byMaterial[white * SIDE_CODES + black] = {&table, false};
+    Slot& mirrored = byMaterial[black * SIDE_CODES + white];
+    if (!mirrored.table) mirrored = {&table, true};
+  }
+  return (int)tables.size();
+}
+
+int maxPieces() { return largest; }
+
+bool probe(const TBPosition& pos, WDL& result) {
+  if (pos.count == 2) {
+    result = DRAW;
+    return true;
+  }
+  if (pos.count > MAX_PIECES) return false;
+
+  // Tables have the stronger side as White: otherwise swap the colors
+  const Slot& slot = byMaterial[sideCode(pos.piece, pos.color, pos.count, WHITE) * SIDE_CODES +
+                                sideCode(pos.piece, pos.color, pos.count, BLACK)];
+  if (!slot.table) return false;
+  const Table& table = *slot.table;
+  const Material& material = table.material;
+  bool flip = slot.flip;
+
+  int squares[MAX_PIECES];
+  bool used[MAX_PIECES] = {};
+  for (int k = 0; k < material.count; k++) {
+    for (int i = 0; i < pos.count; i++) {
+      Color color = flip ? (pos.color[i] == WHITE ? BLACK : WHITE) : pos.color[i];
+      if (!used[i] && pos.piece[i] == material.piece[k] && color == material.color[k]) {
+        squares[k] = flip ? pos.square[i] ^ 56 : pos.square[i];
+        used[i] = true;
+        break;
+      }
+    }
+  }
+
+  Color stm = flip ? (pos.sideToMove == WHITE ? BLACK : WHITE) : pos.sideToMove;
+  Stored value = lookup(table, material.index(squares, stm));
+  result = value == STORED_WIN ? WIN : value == STORED_LOSS ? LOSS : DRAW;
+  return true;
+}
+
+bool probe(const Position& pos, WDL& result) {
+  if (__builtin_popcountll(pos.occupancies[2]) > largest) return false;
+
+  TBPosition tb;
+  for (int c = WHITE; c <= BLACK; c++) {
+    for (int p = PAWN; p <= KING; p++) {
+      uint64_t bb = pos.pieces[c][p];
+      while (bb) {
+        tb.piece[tb.count] = p;
+        tb.color[tb.count] = (Color)c;
+        tb.square[tb.count] = __builtin_ctzll(bb);
+        tb.count++;
+        bb &= (bb - 1);
+      }
+    }
+  }
+  tb.sideToMove = pos.mSideToMove;
+  return probe(tb, result);
+}
+
+bool write(const std::string& path, const std::vector<uint8_t>& values) {
+  Header header;
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.positions = (uint32_t)values.size();
+  header.blocks = (uint32_t)((values.size() + BLOCK_SIZE - 1) / BLOCK_SIZE);
+
+  std::vector<uint32_t> offsets{0};
+  std::vector<unsigned char> data;
+  for (size_t start = 0; start < values.size(); start += BLOCK_SIZE) {
+    size_t end = std::min(values.size(), start + BLOCK_SIZE);
+
+    // Illegal positions join whichever run they fall into
+    int current = STORED_DRAW;
+    for (size_t i = start; i < end; i++) {
+      if (values[i] != DONT_CARE) {
+        current = values[i];
+        break;
+      }
+    }
+    uint64_t run = 0;
+    for (size_t i = start; i < end; i++) {
+      if (values[i] == DONT_CARE || values[i] == current) {
+        run++;
+        continue;
+      }
+      emitRun(data, current, run);
+      current = values[i];
+      run = 1;
+    }
+    emitRun(data, current, run);
+    offsets.push_back((uint32_t)data.size());
+  }
+
+  std::ofstream out(path, std::ios::binary);
+  out.write((const char*)&header, sizeof(header));
+  out.write((const char*)offsets.data(), offsets.size() * sizeof(uint32_t));
+  out.write((const char*)data.data(), data.size());
+  return (bool)out;
+}
+
+}  // namespace tablebase
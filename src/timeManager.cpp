@@ -0,0 +1,82 @@
+#include "../include/timeManager.hpp"
+
+#include <algorithm>
+#include <climits>
+
+// Sudden death: assume this many moves are left in the game
+const int DEFAULT_MOVES_TO_GO = 30;
+const int MAX_MOVES_TO_GO = 50;
+// The hard limit may stretch the nominal share by this factor...
+const int HARD_LIMIT_FACTOR = 4;
+// ...but never beyond this fraction of the remaining clock
+const double MAX_CLOCK_SHARE = 0.75;
+// Each iteration costs roughly this many times the previous one
+const int EFFECTIVE_BRANCHING = 2;
+
+long long TimeManager::nowMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void TimeManager::init(const SearchLimits& limits, Color us, int moveOverhead) {
+  mStartMs = nowMs();
+  mBestMoveChanges = 0.0;
+  mStableIterations = 0;
+  mFixed = false;
+  mEnabled = limits.usesClock() && !limits.infinite;
+
+  if (!mEnabled) {
+    mSoftBase = mSoft = mHard = INT_MAX;
+    return;
+  }
+
+  if (limits.moveTime) {
+    mFixed = true;
+    mSoftBase = mSoft = mHard = std::max(1, limits.moveTime - moveOverhead);
+    return;
+  }
+
+  int movesToGo = limits.movesToGo ? std::min(limits.movesToGo, MAX_MOVES_TO_GO)
+                                   : DEFAULT_MOVES_TO_GO;
+  // Every move still to be played pays the overhead once
+  int available = std::max(1, limits.time[us] - moveOverhead * std::min(movesToGo, 10));
+  int increment = limits.inc[us] * 3 / 4;
+
+  int maxShare = std::max(1, (int)(available * MAX_CLOCK_SHARE));
+  mSoftBase = std::min(available / movesToGo + increment, maxShare);
+  mSoftBase = std::max(1, mSoftBase);
+  mHard = std::min(mSoftBase * HARD_LIMIT_FACTOR, maxShare);
+  mHard = std::max(mHard, mSoftBase);
+  mSoft = mSoftBase;
+}
+
+long long TimeManager::elapsed() const { return nowMs() - mStartMs; }
+
+bool TimeManager::hardLimitReached() const { return mEnabled && elapsed() >= mHard; }
+
+bool TimeManager::canStartIteration(long long lastIterationMs) const {
+  if (!mEnabled) return true;
+
+  long long now = elapsed();
+  if (now >= mSoft) return false;
+  // With a fixed movetime there is nothing to save; use the whole budget
+  if (mFixed) return true;
+  return now + lastIterationMs * EFFECTIVE_BRANCHING <= mHard;
+}
+
+void TimeManager::update(bool bestMoveChanged, int scoreDrop) {
+  if (!mEnabled || mFixed) return;
+
+  // Recent best-move changes count fully, older ones fade out
+  mBestMoveChanges = mBestMoveChanges / 2 + (bestMoveChanged ? 1.0 : 0.0);
+  mStableIterations = bestMoveChanged ? 0 : mStableIterations + 1;
+
+  double instability = 1.0 + 0.5 * mBestMoveChanges;
+  double falling = 1.0 + std::clamp(scoreDrop, 0, 60) / 100.0;
+  double stable = mStableIterations >= 4 ? 0.6 : 1.0;
+
+  mSoft = std::clamp((int)(mSoftBase * instability * falling * stable), 1, mHard);
+}
+
+void TimeManager::ponderhit() { mStartMs = nowMs(); }
@@ -1,43 +1,112 @@
 #include "../include/transposition.hpp"
 
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <new>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../include/engine.hpp"
 
-static const int MATE_BOUND = 900000;
+// Mate and tablebase win scores count down with the ply from the root; anything
+// beyond the lowest tablebase win is stored relative to the node instead
+static const int WIN_BOUND = Engine::TB_WIN - Engine::MAX_PLY;
+static const int INF_SCORE = 1000000;
+static const size_t HUGE_PAGE = 2 * 1024 * 1024;
+static const size_t CLEAR_SLICE = 16 * 1024 * 1024;
 
 TranspositionTable::TranspositionTable(int sizeInMB) {
-  size_t bytes = sizeInMB * 1024 * 1024;
+  if (!resize(sizeInMB)) throw std::bad_alloc();
+
+  std::cout << "TT Initialized with " << numBuckets << " buckets (" << numBuckets * 4
+            << " entries)." << std::endl;
+}
+
+bool TranspositionTable::resize(int sizeInMB) {
+  size_t bytes = (size_t)sizeInMB * 1024 * 1024;
 
   size_t targetBuckets = bytes / sizeof(TTBucket);
 
-  numBuckets = 1;
-  while (numBuckets * 2 <= targetBuckets) {
-    numBuckets *= 2;
+  size_t count = 1;
+  while (count * 2 <= targetBuckets) {
+    count *= 2;
   }
 
-  buckets.resize(numBuckets);
+  // Whole huge pages on a huge page boundary: map one page more than needed and trim
+  // both ends. Anonymous memory arrives zeroed, so a fresh table needs no clear, and
+  // pages are only touched (and faulted in) as the search fills them. The old table
+  // goes only once the new one is mapped.
+  size_t tableBytes = (count * sizeof(TTBucket) + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+  void* mem = mmap(nullptr, tableBytes + HUGE_PAGE, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED) return false;
+
+  uintptr_t start = ((uintptr_t)mem + HUGE_PAGE - 1) & ~(uintptr_t)(HUGE_PAGE - 1);
+  size_t head = start - (uintptr_t)mem;
+  if (head) munmap(mem, head);
+  munmap((char*)start + tableBytes, HUGE_PAGE - head);
+
+  madvise((void*)start, tableBytes, MADV_HUGEPAGE);
+  release();
+  buckets = (TTBucket*)start;
+  numBuckets = count;
+  mMappedBytes = tableBytes;
+  return true;
+}
 
-  std::cout << "TT Initialized with " << numBuckets << " buckets (" << numBuckets * 4
-            << " entries)." << std::endl;
+void TranspositionTable::release() {
+  if (buckets) munmap(buckets, mMappedBytes);
+  buckets = nullptr;
+  numBuckets = 0;
+  mMappedBytes = 0;
 }
 
-TranspositionTable::~TranspositionTable() {}
+TranspositionTable::~TranspositionTable() { release(); }
+
+void TranspositionTable::clear(int threads) {
+  // One contiguous slice per thread; below CLEAR_SLICE bytes a thread costs more than
+  // it saves
+  size_t bytes = numBuckets * sizeof(TTBucket);
+  size_t slices = std::clamp(bytes / CLEAR_SLICE, (size_t)1, (size_t)std::max(1, threads));
+  size_t perSlice = numBuckets / slices;
+
+  auto zero = [this](size_t begin, size_t end) {
+    std::memset((void*)(buckets + begin), 0, (end - begin) * sizeof(TTBucket));
+  };
 
-void TranspositionTable::clear() {
-  std::fill(buckets.begin(), buckets.end(), TTBucket());
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < slices; i++) {
+    workers.emplace_back(zero, i * perSlice, i + 1 == slices ? numBuckets : (i + 1) * perSlice);
+  }
+  zero(0, perSlice);
+  for (std::thread& worker : workers) worker.join();
 }
 
 int TranspositionTable::scoreToTT(int score, int ply) {
-  if (score > MATE_BOUND) return score + ply;
-  if (score < -MATE_BOUND) return score - ply;
+  if (score > WIN_BOUND) return score + ply;
+  if (score < -WIN_BOUND) return score - ply;
   return score;
 }
 
 int TranspositionTable::scoreFromTT(int score, int ply) {
-  if (score > MATE_BOUND) return score - ply;
-  if (score < -MATE_BOUND) return score + ply;
+  if (score > WIN_BOUND) return score - ply;
+  if (score < -WIN_BOUND) return score + ply;
   return score;
 }
 
+bool TranspositionTable::read(const TTEntry& entry, uint64_t key, TTData& out) {
+  uint64_t data = entry.data.load(std::memory_order_relaxed);
+  if ((entry.keyXorData.load(std::memory_order_relaxed) ^ data) != key) return false;
+  out = TTData::unpack(data);
+  return true;
+}
+
 void TranspositionTable::store(uint64_t key, int depth, int ply, int score, uint8_t flag,
                                Move move) {
   // Use the key to find the bucket index
@@ -48,24 +117,30 @@ void TranspositionTable::store(uint64_t key, int depth, int ply, int score, uint
 
   for (int i = 0; i < 4; i++) {
     const TTEntry& entry = bucket.entries[i];
-    if (entry.key == key || entry.key == 0) {
+    uint64_t entryKey = entry.key();
+    if (entryKey == key || entryKey == 0) {
       replaceIndex = i;
       break;
     }
-    if (entry.depth < lowestDepth) {
-      lowestDepth = entry.depth;
+    int entryDepth = TTData::unpack(entry.data.load(std::memory_order_relaxed)).depth;
+    if (entryDepth < lowestDepth) {
+      lowestDepth = entryDepth;
       replaceIndex = i;
     }
   }
   if (replaceIndex == -1) replaceIndex = 0;  // Safety fallback
 
+  TTData d;
+  d.move = TTMove(move);
+  d.score = scoreToTT(score, ply);
+  d.depth = (uint8_t)depth;
+  d.flag = flag;
+  d.generation = 1;
+  uint64_t data = d.pack();
+
   TTEntry& entry = bucket.entries[replaceIndex];
-  entry.key = key;
-  entry.move = TTMove(move);
-  entry.score = scoreToTT(score, ply);
-  entry.depth = (uint8_t)depth;
-  entry.flag = flag;
-  entry.generation = 1;
+  entry.keyXorData.store(key ^ data, std::memory_order_relaxed);
+  entry.data.store(data, std::memory_order_relaxed);
 }
 
 bool TranspositionTable::probe(uint64_t key, int depth, int ply, int alpha, int beta, int& outScore,
@@ -73,9 +148,9 @@ bool TranspositionTable::probe(uint64_t key, int depth, int ply, int alpha, int
   const TTBucket& bucket = buckets[key & (numBuckets - 1)];
 
   for (int i = 0; i < 4; i++) {
-    const TTEntry& entry = bucket.entries[i];
+    TTData entry;
 
-    if (entry.key == key) {
+    if (read(bucket.entries[i], key, entry)) {
       outMove = entry.move.toMove();
 
       if (entry.depth >= depth) {
@@ -103,9 +178,68 @@ Move TranspositionTable::probeMove(uint64_t key) {
   const TTBucket& bucket = buckets[key & (numBuckets - 1)];
 
   for (int i = 0; i < 4; i++) {
-    if (bucket.entries[i].key == key) {
-      return bucket.entries[i].move.toMove();
+    TTData entry;
+    if (read(bucket.entries[i], key, entry)) {
+      return entry.move.toMove();
     }
   }
   return Move::null();
 }
+
+// Every thread writes entries whose move/score/depth are a pure function of the key
+// into the same 1 MB table, and checks every hit against that function. With plain
+// (non-atomic, multi-field) entries the mismatches show up within milliseconds.
+uint64_t TranspositionTable::stressTest(int numThreads, int seconds) {
+  TranspositionTable table(1);
+  std::atomic<uint64_t> torn{0};
+  std::atomic<uint64_t> hits{0};
+  std::atomic<uint64_t> ops{0};
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+
+  auto expected = [](uint64_t key, Move& m, int& score, int& depth) {
+    m = {(uint8_t)(key & 63), (uint8_t)((key >> 6) & 63), NOPIECE, 0, 0};
+    score = (int)((key >> 12) & 0x3FFF) - 8192;
+    depth = 1 + (int)((key >> 26) & 63);
+  };
+
+  std::vector<std::thread> workers;
+  for (int t = 0; t < numThreads; t++) {
+    workers.emplace_back([&, t]() {
+      std::mt19937_64 gen(0x9E3779B97F4A7C15ULL * (t + 1));
+      // A small key pool keeps every thread colliding on the same buckets
+      std::uniform_int_distribution<uint64_t> pick(1, 1 << 16);
+      uint64_t localOps = 0, localHits = 0, localTorn = 0;
+
+      while (std::chrono::steady_clock::now() < deadline) {
+        for (int i = 0; i < 4096; i++) {
+          uint64_t key = pick(gen) * 0xD6E8FEB86659FD93ULL;
+          Move m;
+          int score, depth;
+          expected(key, m, score, depth);
+
+          if (i & 1) {
+            table.store(key, depth, 0, score, TT_EXACT, m);
+          } else {
+            int outScore = 0;
+            Move outMove = Move::null();
+            if (table.probe(key, 0, 0, -INF_SCORE, INF_SCORE, outScore, outMove)) {
+              localHits++;
+              if (outScore != score || outMove.from != m.from || outMove.to != m.to) {
+                localTorn++;
+              }
+            }
+          }
+          localOps++;
+        }
+      }
+      ops += localOps;
+      hits += localHits;
+      torn += localTorn;
+    });
+  }
+  for (auto& w : workers) w.join();
+
+  std::cout << "ttstress threads " << numThreads << " ops " << ops << " hits " << hits
+            << " torn " << torn << std::endl;
+  return torn;
+}
@@ -0,0 +1,144 @@
+// Retrograde KPK solver, run at build time. Writes the bitbase as a C++ array that
+// src/bitbase.cpp includes.
+//
+// usage: kpk_generator <output.inc>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "../include/bitbase.hpp"
+
+namespace {
+
+enum Result : uint8_t { INVALID = 0, UNKNOWN = 1, DRAW = 2, WIN = 4 };
+
+int distance(int a, int b) { return std::max(std::abs(a % 8 - b % 8), std::abs(a / 8 - b / 8)); }
+
+// White pawn on 'pawn' attacks 'sq'
+bool pawnAttacks(int pawn, int sq) {
+  return sq / 8 == pawn / 8 + 1 && std::abs(sq % 8 - pawn % 8) == 1;
+}
+
+struct KPKPosition {
+  Color stm;
+  int king[COLOR_NB];
+  int pawn;
+  Result result;
+};
+
+KPKPosition decode(int index) {
+  KPKPosition p;
+  p.stm = Color(index & 1);
+  p.king[BLACK] = (index >> 1) & 63;
+  p.king[WHITE] = (index >> 7) & 63;
+  int pawnIndex = index >> 13;
+  p.pawn = (pawnIndex / 4 + 1) * 8 + pawnIndex % 4;
+  return p;
+}
+
+Result initialResult(const KPKPosition& p) {
+  int wk = p.king[WHITE], bk = p.king[BLACK], pawn = p.pawn;
+
+  if (wk == bk || wk == pawn || bk == pawn || distance(wk, bk) <= 1) return INVALID;
+  // Black in check with White to move
+  if (p.stm == WHITE && pawnAttacks(pawn, bk)) return INVALID;
+
+  // White promotes safely
+  int queening = pawn + 8;
+  if (p.stm == WHITE && pawn / 8 == 6 && wk != queening && bk != queening &&
+      (distance(bk, queening) > 1 || distance(wk, queening) == 1)) {
+    return WIN;
+  }
+
+  if (p.stm == BLACK) {
+    bool canMove = false;
+    for (int sq = 0; sq < 64; sq++) {
+      if (distance(bk, sq) != 1 || distance(wk, sq) <= 1 || pawnAttacks(pawn, sq)) continue;
+      // Taking an undefended pawn draws
+      if (sq == pawn) return DRAW;
+      canMove = true;
+    }
+    if (!canMove) return DRAW;  // Stalemate (checkmate is impossible with K+P)
+  }
+
+  return UNKNOWN;
+}
+
+// Combines the results of all moves: White needs one winning move, Black one drawing move
+Result classify(const std::vector<KPKPosition>& db, const KPKPosition& p) {
+  int wk = p.king[WHITE], bk = p.king[BLACK], pawn = p.pawn;
+  uint8_t r = INVALID;
+
+  if (p.stm == WHITE) {
+    for (int sq = 0; sq < 64; sq++) {
+      if (distance(wk, sq) != 1 || sq == pawn) continue;
+      r |= db[bitbase::kpkIndex(BLACK, sq, bk, pawn)].result;
+    }
+    // Pushes; promotion itself was settled by initialResult
+    if (pawn / 8 < 6) {
+      int push = pawn + 8;
+      if (push != wk && push != bk) {
+        r |= db[bitbase::kpkIndex(BLACK, wk, bk, push)].result;
+        if (pawn / 8 == 1 && push + 8 != wk && push + 8 != bk) {
+          r |= db[bitbase::kpkIndex(BLACK, wk, bk, push + 8)].result;
+        }
+      }
+    }
+    return (r & WIN) ? WIN : (r & UNKNOWN) ? UNKNOWN : DRAW;
+  }
+
+  for (int sq = 0; sq < 64; sq++) {
+    if (distance(bk, sq) != 1 || sq == pawn) continue;
+    r |= db[bitbase::kpkIndex(WHITE, wk, sq, pawn)].result;
+  }
+  return (r & DRAW) ? DRAW : (r & UNKNOWN) ? UNKNOWN : WIN;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc != 2) {
+    std::cerr << "usage: kpk_generator <output.inc>" << std::endl;
+    return 1;
+  }
+
+  std::vector<KPKPosition> db(bitbase::KPK_SIZE);
+  for (int i = 0; i < bitbase::KPK_SIZE; i++) {
+    db[i] = decode(i);
+    db[i].result = initialResult(db[i]);
+  }
+
+  // Iterate to a fixed point; whatever is still unknown then can't be won
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (KPKPosition& p : db) {
+      if (p.result != UNKNOWN) continue;
+      p.result = classify(db, p);
+      changed |= p.result != UNKNOWN;
+    }
+  }
+
+  std::vector<uint32_t> bits(bitbase::KPK_SIZE / 32, 0);
+  int wins = 0;
+  for (int i = 0; i < bitbase::KPK_SIZE; i++) {
+    if (db[i].result == WIN) {
+      bits[i / 32] |= 1u << (i % 32);
+      wins++;
+    }
+  }
+
+  std::ofstream out(argv[1]);
+  out << "// Generated by tools/kpkGenerator.cpp. Do not edit.\n";
+  out << "// " << wins << " won positions\n";
+  out << "static constexpr uint32_t KPK_BITS[" << bits.size() << "] = {";
+  for (size_t i = 0; i < bits.size(); i++) {
+    out << (i % 8 == 0 ? "\n    " : " ") << "0x" << std::hex << bits[i] << std::dec << ",";
+  }
+  out << "\n};\n";
+  return out ? 0 : 1;
+}
@@ -0,0 +1,370 @@
+// Retrograde solver for the 3- and 4-man WDL tables read by src/tablebase.cpp.
+// Tables are built smallest first so that captures and promotions can be resolved by
+// probing the ones already written; tables within a stage are solved in parallel.
+//
+// usage: tb_generator <dir> [threads] [table...]
+// Existing files in <dir> are kept; naming tables restricts the run to those.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../include/attack.hpp"
+#include "../include/magicBitboards.hpp"
+#include "../include/tablebase.hpp"
+
+namespace {
+
+using tablebase::Material;
+
+// Per-position solver state: the value (or UNKNOWN) in the low bits plus flags
+constexpr uint8_t VALUE_MASK = 3, UNKNOWN = 3, PENDING = 4, DRAW_EXIT = 8, ILLEGAL = 16;
+
+constexpr int PROMOTIONS[] = {QUEEN, ROOK, BISHOP, KNIGHT};
+
+std::mutex outputMutex;
+
+inline uint64_t bit(int sq) { return 1ULL << sq; }
+
+Color opposite(Color c) { return c == WHITE ? BLACK : WHITE; }
+
+uint64_t attacks(int piece, Color color, int sq, uint64_t occ) {
+  switch (piece) {
+    case PAWN:
+      return attack::pawnAttacks[color][sq];
+    case KNIGHT:
+      return attack::knightAttacks[sq];
+    case BISHOP:
+      return get_bishop_attacks(sq, occ);
+    case ROOK:
+      return get_rook_attacks(sq, occ);
+    case QUEEN:
+      return get_bishop_attacks(sq, occ) | get_rook_attacks(sq, occ);
+    default:
+      return attack::kingAttacks[sq];
+  }
+}
+
+// Unreduced index over all placements: no symmetry, which keeps moves and unmoves trivial
+class Solver {
+ public:
+  explicit Solver(const std::string& name)
+      : mMaterial(name), mCount(mMaterial.count), mSize(2ULL << (6 * mCount)) {}
+
+  bool run(const std::string& dir);
+
+ private:
+  void decode(uint64_t index, int* sq, Color& stm) const {
+    stm = Color(index & 1);
+    index >>= 1;
+    for (int i = 0; i < mCount; i++, index >>= 6) sq[i] = index & 63;
+  }
+
+  uint64_t encode(const int* sq, Color stm) const {
+    uint64_t index = 0;
+    for (int i = mCount - 1; i >= 0; i--) index = (index << 6) | sq[i];
+    return (index << 1) | stm;
+  }
+
+  uint64_t occupancy(const int* sq, Color color) const {
+    uint64_t occ = 0;
+    for (int i = 0; i < mCount; i++) {
+      if (mMaterial.color[i] == color) occ |= bit(sq[i]);
+    }
+    return occ;
+  }
+
+  // Whether 'by' attacks 'target', ignoring the piece in slot 'skip' (just captured)
+  bool attacked(const int* sq, int target, Color by, uint64_t occ, int skip = -1) const {
+    for (int i = 0; i < mCount; i++) {
+      if (i != skip && mMaterial.color[i] == by &&
+          (attacks(mMaterial.piece[i], by, sq[i], occ) & bit(target))) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool legal(const int* sq, Color stm) const {
+    uint64_t occ = 0;
+    for (int i = 0; i < mCount; i++) {
+      if (occ & bit(sq[i])) return false;
+      if (mMaterial.piece[i] == PAWN && (sq[i] < 8 || sq[i] >= 56)) return false;
+      occ |= bit(sq[i]);
+    }
+    if (attack::kingAttacks[sq[0]] & bit(sq[1])) return false;
+    Color them = opposite(stm);
+    return !attacked(sq, sq[them == WHITE ? 0 : 1], stm, occ);
+  }
+
+  uint8_t initialState(const int* sq, Color stm, uint8_t& inTableMoves) const;
+  bool probeExit(const int* sq, int captured, int mover, int promotion, Color stm,
+                 tablebase::WDL& result) const;
+
+  template <typename Visit>
+  void forEachPredecessor(const int* sq, Color stm, Visit visit) const;
+
+  Material mMaterial;
+  int mCount;
+  uint64_t mSize;
+  std::vector<uint8_t> mState;
+  std::vector<uint8_t> mMoves;  // In-table moves not yet refuted
+  mutable bool mMissingTable = false;
+};
+
+// Value after a capture and/or promotion, looked up in a smaller or earlier table
+bool Solver::probeExit(const int* sq, int captured, int mover, int promotion, Color stm,
+                       tablebase::WDL& result) const {
+  tablebase::TBPosition next;
+  for (int i = 0; i < mCount; i++) {
+    if (i == captured) continue;
+    next.piece[next.count] = (i == mover && promotion != NOPIECE) ? promotion : mMaterial.piece[i];
+    next.color[next.count] = mMaterial.color[i];
+    next.square[next.count] = sq[i];
+    next.count++;
+  }
+  next.sideToMove = opposite(stm);
+  if (!tablebase::probe(next, result)) {
+    mMissingTable = true;
+    return false;
+  }
+  result = tablebase::WDL(-result);
+  return true;
+}
+
+uint8_t Solver::initialState(const int* sq, Color stm, uint8_t& inTableMoves) const {
+  Color them = opposite(stm);
+  uint64_t own = occupancy(sq, stm), enemy = occupancy(sq, them), occ = own | enemy;
+  int legalMoves = 0;
+  bool drawExit = false;
+  inTableMoves = 0;
+
+  for (int i = 0; i < mCount; i++) {
+    if (mMaterial.color[i] != stm) continue;
+    int from = sq[i], piece = mMaterial.piece[i];
+
+    uint64_t targets;
+    if (piece == PAWN) {
+      int up = stm == WHITE ? 8 : -8;
+      targets = attack::pawnAttacks[stm][from] & enemy;
+      if (!(occ & bit(from + up))) {
+        targets |= bit(from + up);
+        int startRank = stm == WHITE ? 1 : 6;
+        if (from / 8 == startRank && !(occ & bit(from + 2 * up))) targets |= bit(from + 2 * up);
+      }
+    } else {
+      targets = attacks(piece, stm, from, occ) & ~own;
+    }
+
+    while (targets) {
+      int to = __builtin_ctzll(targets);
+      targets &= targets - 1;
+
+      int captured = -1;
+      for (int j = 0; j < mCount; j++) {
+        if (sq[j] == to && mMaterial.color[j] == them) captured = j;
+      }
+      int next[tablebase::MAX_PIECES];
+      for (int j = 0; j < mCount; j++) next[j] = j == i ? to : sq[j];
+      uint64_t nextOcc = (occ ^ bit(from)) | bit(to);
+      if (attacked(next, next[stm == WHITE ? 0 : 1], them, nextOcc, captured)) continue;
+      legalMoves++;
+
+      bool promotes = piece == PAWN && (to < 8 || to >= 56);
+      if (captured < 0 && !promotes) {
+        inTableMoves++;
+        continue;
+      }
+      for (int promotion : PROMOTIONS) {
+        tablebase::WDL result;
+        if (!probeExit(next, captured, i, promotes ? promotion : NOPIECE, stm, result)) {
+          return UNKNOWN;
+        }
+        if (result == tablebase::WIN) return tablebase::STORED_WIN;
+        if (result == tablebase::DRAW) drawExit = true;
+        if (!promotes) break;
+      }
+    }
+  }
+
+  if (legalMoves == 0) {
+    bool inCheck = attacked(sq, sq[stm == WHITE ? 0 : 1], them, occ);
+    return inCheck ? tablebase::STORED_LOSS : tablebase::STORED_DRAW;
+  }
+  if (inTableMoves == 0) return drawExit ? tablebase::STORED_DRAW : tablebase::STORED_LOSS;
+  return UNKNOWN | (drawExit ? DRAW_EXIT : 0);
+}
+
+// Positions whose side to move reaches 'sq' with a quiet, in-table move
+template <typename Visit>
+void Solver::forEachPredecessor(const int* sq, Color stm, Visit visit) const {
+  Color mover = opposite(stm);
+  uint64_t occ = occupancy(sq, WHITE) | occupancy(sq, BLACK);
+  int prev[tablebase::MAX_PIECES];
+  for (int i = 0; i < mCount; i++) prev[i] = sq[i];
+
+  for (int i = 0; i < mCount; i++) {
+    if (mMaterial.color[i] != mover) continue;
+    int to = sq[i];
+
+    uint64_t origins;
+    if (mMaterial.piece[i] == PAWN) {
+      int down = mover == WHITE ? -8 : 8;
+      int rank = to / 8, firstPush = mover == WHITE ? 2 : 5, doublePush = mover == WHITE ? 3 : 4;
+      origins = 0;
+      if ((mover == WHITE ? rank >= firstPush : rank <= firstPush) && !(occ & bit(to + down))) {
+        origins |= bit(to + down);
+        if (rank == doublePush && !(occ & bit(to + 2 * down))) origins |= bit(to + 2 * down);
+      }
+    } else {
+      origins = attacks(mMaterial.piece[i], mover, to, occ) & ~occ;
+    }
+
+    while (origins) {
+      prev[i] = __builtin_ctzll(origins);
+      origins &= origins - 1;
+      visit(encode(prev, mover));
+    }
+    prev[i] = to;
+  }
+}
+
+bool Solver::run(const std::string& dir) {
+  auto start = std::chrono::steady_clock::now();
+  mState.assign(mSize, UNKNOWN);
+  mMoves.assign(mSize, 0);
+
+  int sq[tablebase::MAX_PIECES];
+  Color stm;
+  for (uint64_t index = 0; index < mSize; index++) {
+    decode(index, sq, stm);
+    if (!legal(sq, stm)) {
+      mState[index] = ILLEGAL;
+      continue;
+    }
+    mState[index] = initialState(sq, stm, mMoves[index]);
+    if (mMissingTable) {
+      std::lock_guard<std::mutex> lock(outputMutex);
+      std::cerr << mMaterial.name << ": a table it converts into is missing" << std::endl;
+      return false;
+    }
+    if ((mState[index] & VALUE_MASK) != tablebase::STORED_DRAW &&
+        (mState[index] & VALUE_MASK) != UNKNOWN) {
+      mState[index] |= PENDING;
+    }
+  }
+
+  // Propagate decided wins and losses back until nothing changes
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (uint64_t index = 0; index < mSize; index++) {
+      if (!(mState[index] & PENDING)) continue;
+      mState[index] &= ~PENDING;
+      bool lost = (mState[index] & VALUE_MASK) == tablebase::STORED_LOSS;
+      decode(index, sq, stm);
+
+      forEachPredecessor(sq, stm, [&](uint64_t prev) {
+        uint8_t& state = mState[prev];
+        if ((state & (ILLEGAL | VALUE_MASK)) != UNKNOWN) return;
+        if (lost) {
+          state = tablebase::STORED_WIN | PENDING;
+        } else if (--mMoves[prev] == 0) {
+          state = (state & DRAW_EXIT) ? tablebase::STORED_DRAW : tablebase::STORED_LOSS | PENDING;
+        }
+        changed = true;
+      });
+    }
+  }
+
+  // Keep only the positions the reduced index maps to
+  std::vector<uint8_t> values(mMaterial.size());
+  uint64_t counts[3] = {0, 0, 0};
+  for (uint64_t index = 0; index < values.size(); index++) {
+    mMaterial.decode(index, sq, stm);
+    uint8_t state = mState[encode(sq, stm)];
+    if (state & ILLEGAL) {
+      values[index] = tablebase::DONT_CARE;
+      continue;
+    }
+    int value = state & VALUE_MASK;
+    values[index] = value == UNKNOWN ? tablebase::STORED_DRAW : value;
+    counts[values[index]]++;
+  }
+  mState.clear();
+  mState.shrink_to_fit();
+  mMoves.clear();
+  mMoves.shrink_to_fit();
+
+  std::string path = dir + "/" + mMaterial.name + ".wdl";
+  bool written = tablebase::write(path, values);
+  double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  std::lock_guard<std::mutex> lock(outputMutex);
+  if (!written) {
+    std::cerr << "cannot write " << path << std::endl;
+    return false;
+  }
+  std::cout << mMaterial.name << ": " << counts[tablebase::STORED_WIN] << " wins, "
+            << counts[tablebase::STORED_DRAW] << " draws, " << counts[tablebase::STORED_LOSS]
+            << " losses (" << std::filesystem::file_size(path) << " bytes, " << seconds
+            << " s)" << std::endl;
+  return true;
+}
+
+// 3-man pawnless, 3-man with a pawn, then 4-man with 0, 1 and 2 pawns: every capture or
+// promotion leads to a table from an earlier stage
+int stage(const std::string& name) {
+  int pawns = (int)std::count(name.begin(), name.end(), 'P');
+  return name.size() == 4 ? pawns : 2 + pawns;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    std::cerr << "usage: tb_generator <dir> [threads] [table...]" << std::endl;
+    return 1;
+  }
+  std::string dir = argv[1];
+  int threads = argc > 2 ? std::max(1, std::atoi(argv[2])) : 1;
+  std::vector<std::string> wanted(argv + std::min(argc, 3), argv + argc);
+
+  init_magic_bitboards();
+  std::filesystem::create_directories(dir);
+
+  for (int s = 0; s <= 4; s++) {
+    tablebase::init(dir);
+
+    std::vector<std::string> names;
+    for (const std::string& name : tablebase::allTables()) {
+      if (stage(name) != s || std::filesystem::exists(dir + "/" + name + ".wdl")) continue;
+      if (wanted.empty() || std::find(wanted.begin(), wanted.end(), name) != wanted.end()) {
+        names.push_back(name);
+      }
+    }
+
+    std::atomic<size_t> next{0};
+    std::atomic<bool> failed{false};
+    std::vector<std::thread> pool;
+    for (int t = 0; t < std::min<int>(threads, (int)names.size()); t++) {
+      pool.emplace_back([&] {
+        for (size_t i; (i = next++) < names.size();) {
+          if (!Solver(names[i]).run(dir)) failed = true;
+        }
+      });
+    }
+    for (std::thread& thread : pool) thread.join();
+    if (failed) return 1;
+  }
+  return 0;
+}